@@ -0,0 +1,99 @@
+// file      : odb/commit-future.cxx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#include <odb/commit-future.hxx>
+
+#include <odb/details/lock.hxx>
+
+using namespace std;
+
+namespace odb
+{
+  using details::lock;
+
+  commit_future::state::
+  ~state ()
+  {
+  }
+
+  commit_future::
+  commit_future (state* s)
+      : s_ (s)
+  {
+    if (s_ != 0)
+    {
+      lock l (s_->mutex_);
+      s_->refs_++;
+    }
+  }
+
+  commit_future::
+  commit_future (const commit_future& x)
+      : s_ (x.s_)
+  {
+    if (s_ != 0)
+    {
+      lock l (s_->mutex_);
+      s_->refs_++;
+    }
+  }
+
+  commit_future::
+  ~commit_future ()
+  {
+    if (s_ != 0)
+    {
+      bool last;
+      {
+        lock l (s_->mutex_);
+        last = --s_->refs_ == 0;
+      }
+
+      if (last)
+        delete s_;
+    }
+  }
+
+  commit_future& commit_future::
+  operator= (const commit_future& x)
+  {
+    commit_future t (x);
+    swap (t);
+    return *this;
+  }
+
+  void commit_future::
+  swap (commit_future& x)
+  {
+    state* s (s_);
+    s_ = x.s_;
+    x.s_ = s;
+  }
+
+  bool commit_future::
+  ready () const
+  {
+    return s_->ready ();
+  }
+
+  void commit_future::
+  wait () const
+  {
+    s_->wait ();
+  }
+
+  bool commit_future::
+  committed () const
+  {
+    s_->wait ();
+    return s_->committed;
+  }
+
+  const odb::exception* commit_future::
+  exception () const
+  {
+    s_->wait ();
+    return s_->error.get ();
+  }
+}
@@ -0,0 +1,107 @@
+// file      : odb/commit-future.hxx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#ifndef ODB_COMMIT_FUTURE_HXX
+#define ODB_COMMIT_FUTURE_HXX
+
+#include <odb/pre.hxx>
+
+#include <cstddef> // std::size_t
+
+#include <odb/exception.hxx>
+
+#include <odb/details/mutex.hxx>
+#include <odb/details/export.hxx>
+#include <odb/details/shared-ptr.hxx>
+
+namespace odb
+{
+  // Handle for the outcome of a commit that completes asynchronously,
+  // for example, as part of a group commit (see group-commit.hxx).
+  // Copies refer to the same outcome and can be used from different
+  // threads.
+  //
+  class LIBODB_EXPORT commit_future
+  {
+  public:
+    // Return true if the outcome is known.
+    //
+    bool
+    ready () const;
+
+    // Wait until the outcome is known.
+    //
+    void
+    wait () const;
+
+    // Wait and return true if the transaction has been committed and
+    // false if it has been rolled back.
+    //
+    bool
+    committed () const;
+
+    // Wait and return the exception that caused the rollback or NULL if
+    // the transaction has been committed or the cause is not an ODB
+    // exception. Note that the returned object is only valid while this
+    // future (or one of its copies) exists.
+    //
+    const odb::exception*
+    exception () const;
+
+    // Return true if the future refers to a commit.
+    //
+    bool
+    valid () const {return s_ != 0;}
+
+  public:
+    commit_future (): s_ (0) {}
+    ~commit_future ();
+
+    commit_future (const commit_future&);
+    commit_future& operator= (const commit_future&);
+
+    void
+    swap (commit_future&);
+
+    // Implementation details.
+    //
+  public:
+    // The outcome should be set before ready() returns true or wait()
+    // returns. The reference count is protected by its own mutex since
+    // copies may be made and destroyed in different threads.
+    //
+    struct LIBODB_EXPORT state
+    {
+      state (): committed (false), refs_ (0) {}
+
+      virtual
+      ~state ();
+
+      virtual bool
+      ready () = 0;
+
+      virtual void
+      wait () = 0;
+
+      bool committed;
+      details::shared_ptr<odb::exception> error;
+
+    private:
+      friend class commit_future;
+
+      details::mutex mutex_;
+      std::size_t refs_;
+    };
+
+    explicit
+    commit_future (state*);
+
+  private:
+    state* s_;
+  };
+}
+
+#include <odb/post.hxx>
+
+#endif // ODB_COMMIT_FUTURE_HXX
@@ -6,6 +6,7 @@
 #include <odb/connection.hxx>
 #include <odb/result.hxx>
 #include <odb/prepared-query.hxx>
+#include <odb/query-dynamic.hxx>
 #include <odb/exceptions.hxx> // prepared_*
 
 using namespace std;
@@ -17,6 +18,31 @@ namespace odb
   {
     assert (prepared_queries_ == 0);
     assert (prepared_map_.empty ());
+
+    // Normally cleared by the database-specific connection together with
+    // the prepared map but in case it wasn't, at least free the memory.
+    //
+    clear_query_statements ();
+  }
+
+  void connection::
+  mark_failed ()
+  {
+    failed_ = true;
+  }
+
+  bool connection::
+  failed () const
+  {
+    return failed_;
+  }
+
+  transaction_impl* connection::
+  begin_read_only ()
+  {
+    transaction_impl* r (begin ());
+    r->read_only (true);
+    return r;
   }
 
   void connection::
@@ -30,6 +56,149 @@ namespace odb
     }
 
     prepared_map_.clear ();
+
+    clear_query_statements ();
+  }
+
+  void connection::
+  clear_query_statements ()
+  {
+    for (query_statement_list::iterator i (query_statements_.begin ()),
+           e (query_statements_.end ()); i != e; ++i)
+      delete i->structure;
+
+    query_statement_map_.clear ();
+    query_statements_.clear ();
+  }
+
+  void connection::
+  query_statement_cache_size (size_t n)
+  {
+    query_statement_cache_size_ = n;
+    trim_query_statements (n);
+  }
+
+  void connection::
+  trim_query_statements (size_t n)
+  {
+    while (query_statements_.size () > n)
+    {
+      query_statement_list::iterator i (query_statements_.begin ());
+
+      // Find the map entry pointing to this list entry.
+      //
+      for (pair<query_statement_map::iterator,
+             query_statement_map::iterator> r (
+             query_statement_map_.equal_range (i->hash));
+           r.first != r.second; ++r.first)
+      {
+        if (r.first->second == i)
+        {
+          query_statement_map_.erase (r.first);
+          break;
+        }
+      }
+
+      delete i->structure;
+      query_statements_.erase (i);
+    }
+  }
+
+  statement* connection::
+  lookup_query_statement_ (const type_info& ti,
+                           const type_info& si,
+                           size_t h,
+                           const void* q,
+                           structure_equal_function equal)
+  {
+    if (query_statement_cache_size_ == 0)
+      return 0;
+
+    for (pair<query_statement_map::iterator,
+           query_statement_map::iterator> r (
+           query_statement_map_.equal_range (h));
+         r.first != r.second; ++r.first)
+    {
+      query_statement_list::iterator i (r.first->second);
+
+      if (*i->type_info == ti &&
+          *i->statement_info == si &&
+          equal (*i->structure, q))
+      {
+        // Don't return a statement that is still in use, for example,
+        // by an active result.
+        //
+        if (i->stmt->_ref_count () != 1)
+          return 0;
+
+        // Mark as most recently used.
+        //
+        query_statements_.splice (query_statements_.end (),
+                                  query_statements_,
+                                  i);
+        return i->stmt.get ();
+      }
+    }
+
+    return 0;
+  }
+
+  void connection::
+  cache_query_statement_ (const type_info& ti,
+                          const type_info& si,
+                          const query_base& q,
+                          const details::shared_ptr<statement>& s)
+  {
+    if (query_statement_cache_size_ == 0)
+      return;
+
+    size_t h (q.structure_hash ());
+
+    for (pair<query_statement_map::iterator,
+           query_statement_map::iterator> r (
+           query_statement_map_.equal_range (h));
+         r.first != r.second; ++r.first)
+    {
+      query_statement_list::iterator i (r.first->second);
+
+      if (*i->type_info == ti &&
+          *i->statement_info == si &&
+          i->structure->structure_equal (q))
+      {
+        i->stmt = s;
+        query_statements_.splice (query_statements_.end (),
+                                  query_statements_,
+                                  i);
+        return;
+      }
+    }
+
+    // Make room for the new entry.
+    //
+    if (query_statements_.size () == query_statement_cache_size_)
+      trim_query_statements (query_statement_cache_size_ - 1);
+
+    query_statement_entry e;
+    e.hash = h;
+    e.type_info = &ti;
+    e.statement_info = &si;
+    e.structure = 0;
+    e.stmt = s;
+
+    query_statement_list::iterator i (
+      query_statements_.insert (query_statements_.end (), e));
+
+    try
+    {
+      i->structure = new query_base (q.structure ());
+      query_statement_map_.insert (query_statement_map::value_type (h, i));
+    }
+    catch (...)
+    {
+      delete i->structure;
+      query_statements_.erase (i);
+      throw;
+    }
   }
 
   void connection::
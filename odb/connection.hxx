@@ -8,6 +8,7 @@
 #include <odb/pre.hxx>
 
 #include <map>
+#include <list>
 #include <string>
 #include <memory>   // std::auto_ptr, std::unique_ptr
 #include <cstddef>  // std::size_t
@@ -44,6 +45,11 @@ namespace odb
     virtual transaction_impl*
     begin () = 0;
 
+    // Begin a read-only transaction (see database::begin_read_only()).
+    //
+    virtual transaction_impl*
+    begin_read_only ();
+
     // Native database statement execution. Note that unlike the
     // versions in the database class, these can be executed
     // without a transaction.
@@ -95,6 +101,50 @@ namespace odb
     prepared_query<T>
     lookup_query (const char* name, P*& params) const;
 
+    // Dynamic query statement cache. Statements prepared to execute
+    // dynamic (database-independent) queries are cached by the query
+    // structure (see query_base::structure_hash()) so that executing a
+    // query that only differs in parameter values reuses the already
+    // prepared statement. The T argument is the object or view type
+    // and S is the statement type.
+    //
+    // A cached statement is only returned if it is not referenced by
+    // anyone else (e.g., an active query result). Caching a statement
+    // with the same structure replaces the old one. When the cache is
+    // full, the least recently used statement is evicted.
+    //
+    // The lookup query can be either a dynamic query (query_base) or a
+    // static query (see query-static.hxx), in which case the lookup does
+    // not allocate.
+    //
+    // Nothing in the common runtime consults this cache. It is meant for
+    // the database runtimes' dynamic query translation which should look
+    // the statement up before translating the query and cache the newly
+    // prepared one. Note that a cached statement stays bound to the
+    // parameter image of the query it was prepared for. Before executing
+    // it for another query, the caller must rebind it, that is, bind the
+    // statement's parameters to the new query's values. Equal structure
+    // guarantees that the new query has the same parameters, in the same
+    // order, and of the same types, so the parameter layout is the same.
+    //
+  public:
+    template <typename T, typename S, typename Q>
+    details::shared_ptr<S>
+    lookup_query_statement (const Q&);
+
+    template <typename T, typename S>
+    void
+    cache_query_statement (const query_base&, const details::shared_ptr<S>&);
+
+    // Maximum number of cached dynamic query statements. Zero disables
+    // the cache. The default is 64.
+    //
+    void
+    query_statement_cache_size (std::size_t);
+
+    std::size_t
+    query_statement_cache_size () const;
+
     // SQL statement tracing.
     //
   public:
@@ -129,6 +179,23 @@ namespace odb
     void
     recycle ();
 
+    // Mark the connection as failed, for example, after connection_lost
+    // has been thrown (database::transact() does this). A failed
+    // connection should not be returned to the pool once released.
+    //
+    // The database runtimes keep their own failure flag (set, for
+    // example, when the server connection is lost) which their connection
+    // factories check on release. Their mark_failed() and failed()
+    // override these functions so that marking the connection through
+    // this interface sets that flag. The default implementations keep a
+    // flag of their own that nothing in the common runtime acts on.
+    //
+    virtual void
+    mark_failed ();
+
+    virtual bool
+    failed () const;
+
   protected:
     connection (database_type&);
 
@@ -154,6 +221,26 @@ namespace odb
     static void
     params_deleter (void*);
 
+    typedef bool (*structure_equal_function) (const query_base&,
+                                              const void*);
+
+    template <typename Q>
+    static bool
+    structure_equal (const query_base&, const void*);
+
+    statement*
+    lookup_query_statement_ (const std::type_info& ti,
+                             const std::type_info& si,
+                             std::size_t hash,
+                             const void* query,
+                             structure_equal_function);
+
+    void
+    cache_query_statement_ (const std::type_info& ti,
+                            const std::type_info& si,
+                            const query_base&,
+                            const details::shared_ptr<statement>&);
+
   private:
     connection (const connection&);
     connection& operator= (const connection&);
@@ -176,12 +263,48 @@ namespace odb
 
     prepared_map_type prepared_map_;
 
+    // Also clears the dynamic query statement cache.
+    //
     void
     clear_prepared_map ();
 
+    // Dynamic query statement cache.
+    //
+  protected:
+    struct query_statement_entry
+    {
+      std::size_t hash;
+      const std::type_info* type_info;
+      const std::type_info* statement_info;
+      query_base* structure;
+      details::shared_ptr<statement> stmt;
+    };
+
+    typedef std::list<query_statement_entry> query_statement_list;
+
+    typedef
+    std::multimap<std::size_t, query_statement_list::iterator>
+    query_statement_map;
+
+    // The list is in the LRU order with the most recently used entry
+    // at the back.
+    //
+    query_statement_list query_statements_;
+    query_statement_map query_statement_map_;
+    std::size_t query_statement_cache_size_;
+
+    void
+    clear_query_statements ();
+
+    // Evict the least recently used entries until at most n remain.
+    //
+    void
+    trim_query_statements (std::size_t n);
+
   protected:
     database_type& database_;
     tracer_type* tracer_;
+    bool failed_;
 
     // Active query result list.
     //
@@ -9,8 +9,10 @@ namespace odb
 {
   inline connection::
   connection (database_type& database)
-      : database_ (database),
+      : query_statement_cache_size_ (64),
+        database_ (database),
         tracer_ (0),
+        failed_ (false),
         results_ (0),
         prepared_queries_ (0),
         transaction_tracer_ (0)
@@ -106,6 +108,42 @@ namespace odb
                &typeid (P)));
   }
 
+  template <typename Q>
+  inline bool connection::
+  structure_equal (const query_base& s, const void* q)
+  {
+    return static_cast<const Q*> (q)->structure_equal (s);
+  }
+
+  template <typename T, typename S, typename Q>
+  inline details::shared_ptr<S> connection::
+  lookup_query_statement (const Q& q)
+  {
+    S* s (static_cast<S*> (
+            lookup_query_statement_ (typeid (T),
+                                     typeid (S),
+                                     q.structure_hash (),
+                                     &q,
+                                     &structure_equal<Q>)));
+
+    return details::shared_ptr<S> (s != 0 ? details::inc_ref (s) : 0);
+  }
+
+  template <typename T, typename S>
+  inline void connection::
+  cache_query_statement (const query_base& q,
+                         const details::shared_ptr<S>& s)
+  {
+    cache_query_statement_ (
+      typeid (T), typeid (S), q, details::shared_ptr<statement> (s));
+  }
+
+  inline std::size_t connection::
+  query_statement_cache_size () const
+  {
+    return query_statement_cache_size_;
+  }
+
   inline void connection::
   tracer (tracer_type& t)
   {
@@ -2,9 +2,36 @@
 // copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
 // license   : GNU GPL v2; see accompanying LICENSE file
 
+#include <odb/details/config.hxx> // ODB_CXX11
+
+// VC++ 10 does not have <chrono>.
+//
+#if defined(ODB_CXX11) && (!defined(_MSC_VER) || _MSC_VER >= 1700)
+#  include <chrono>
+#  define ODB_BULK_BATCH_CLOCK
+#endif
+
+#include <deque>
+#include <vector>
+
 #include <odb/database.hxx>
+#include <odb/transaction.hxx>
+#include <odb/exceptions.hxx>
 
 #include <odb/details/lock.hxx>
+#include <odb/details/condition.hxx>
+#include <odb/details/unique-ptr.hxx>
+
+#ifndef ODB_THREADS_NONE
+#  include <odb/details/thread.hxx>
+#endif
+
+#ifdef ODB_THREADS_WIN32
+#  include <odb/details/win32/windows.hxx>
+#else
+#  include <time.h>  // nanosleep
+#  include <errno.h>
+#endif
 
 using namespace std;
 
@@ -12,9 +39,144 @@ namespace odb
 {
   using details::lock;
 
+  // Asynchronous commit.
+  //
+  database::async_task::
+  ~async_task ()
+  {
+  }
+
+  struct database::async_committer
+  {
+    async_committer (): cond (mutex), stop (false) {}
+
+    details::mutex mutex;
+    details::condition cond;
+    std::deque<async_task*> queue;
+    bool stop;
+
+#ifndef ODB_THREADS_NONE
+    details::unique_ptr<details::thread> thread;
+#endif
+  };
+
+  void* database::
+  async_worker (void* arg)
+  {
+    async_committer& c (*static_cast<async_committer*> (arg));
+
+    for (;;)
+    {
+      async_task* t;
+      {
+        lock l (c.mutex);
+
+        while (c.queue.empty () && !c.stop)
+          c.cond.wait ();
+
+        if (c.queue.empty ())
+          break;
+
+        t = c.queue.front ();
+        c.queue.pop_front ();
+      }
+
+      t->execute ();
+      delete t;
+    }
+
+    return 0;
+  }
+
+  void database::
+  async_ (async_task* t)
+  {
+    details::unique_ptr<async_task> p (t);
+
+    if (!async_commit_)
+    {
+      p->execute ();
+      return;
+    }
+
+#ifndef ODB_THREADS_NONE
+    async_committer* c;
+    {
+      lock l (async_mutex_);
+
+      if (async_committer_ == 0)
+      {
+        details::unique_ptr<async_committer> n (new async_committer);
+
+        // If we cannot start the thread, then execute the task in the
+        // current thread.
+        //
+        try
+        {
+          n->thread.reset (new details::thread (&async_worker, n.get ()));
+        }
+        catch (...)
+        {
+          l.unlock ();
+          p->execute ();
+          return;
+        }
+
+        async_committer_ = n.release ();
+      }
+
+      c = async_committer_;
+    }
+
+    lock l (c->mutex);
+    c->queue.push_back (p.get ());
+    p.release ();
+    c->cond.signal ();
+#else
+    p->execute ();
+#endif
+  }
+
+  void database::
+  wait_async ()
+  {
+    // Detach the committer so that the commits submitted from now on are
+    // handled by a new one, then let it drain its queue and stop.
+    //
+    async_committer* c;
+    {
+      lock l (async_mutex_);
+      c = async_committer_;
+      async_committer_ = 0;
+    }
+
+    if (c == 0)
+      return;
+
+#ifndef ODB_THREADS_NONE
+    {
+      lock l (c->mutex);
+      c->stop = true;
+      c->cond.signal ();
+    }
+
+    c->thread->join ();
+#endif
+    delete c;
+  }
+
   database::
   ~database ()
   {
+    wait_async ();
+  }
+
+  transaction_impl* database::
+  begin_read_only ()
+  {
+    transaction_impl* r (begin ());
+    r->read_only (true);
+    return r;
   }
 
   unsigned long long database::
@@ -81,4 +243,404 @@ namespace odb
     else
       query_factory_map_.erase (name);
   }
+
+  // Bulk operation batch sizing.
+  //
+  static unsigned long long
+  bulk_batch_now ()
+  {
+#ifdef ODB_BULK_BATCH_CLOCK
+    using namespace std::chrono;
+
+    // Make sure 0 (no time) is never returned.
+    //
+    return static_cast<unsigned long long> (
+      duration_cast<microseconds> (
+        steady_clock::now ().time_since_epoch ()).count ()) | 1;
+#else
+    return 0;
+#endif
+  }
+
+  void database::
+  bulk_batch_adaptive (bool a, unsigned long latency)
+  {
+    lock l (bulk_batch_mutex_);
+
+    bulk_batch_adaptive_ = a;
+    bulk_batch_latency_ = latency;
+    bulk_batch_map_.clear ();
+  }
+
+  database::bulk_batch database::
+  bulk_batch_begin_ (const type_info& ti, size_t max)
+  {
+    bulk_batch r;
+
+    {
+      lock l (bulk_batch_mutex_);
+
+      bulk_batch_map::const_iterator i (bulk_batch_map_.find (&ti));
+
+      if (i != bulk_batch_map_.end ())
+        r.size = i->second;
+      else
+        r.size = bulk_batch_size_ != 0 ? bulk_batch_size_ : max;
+    }
+
+    if (r.size > max)
+      r.size = max;
+
+    r.start = bulk_batch_now ();
+    return r;
+  }
+
+  void database::
+  bulk_batch_end_ (const type_info& ti,
+                   const bulk_batch& b,
+                   size_t n,
+                   size_t max,
+                   size_t failed)
+  {
+    // Only adjust based on full batches. A short one is the tail of the
+    // range and says little about the optimal size.
+    //
+    if (n != b.size)
+      return;
+
+    unsigned long long end (bulk_batch_now ());
+    bool slow (b.start != 0 &&
+               end - b.start >
+               static_cast<unsigned long long> (bulk_batch_latency_) * 1000);
+
+    lock l (bulk_batch_mutex_);
+
+    size_t& r (bulk_batch_map_[&ti]);
+
+    if (failed * 4 > n || slow)
+      r = n > 1 ? n / 2 : 1;
+    else if (failed == 0)
+    {
+      size_t m (bulk_batch_size_ != 0 && bulk_batch_size_ < max
+                ? bulk_batch_size_
+                : max);
+
+      r = n < m / 2 ? n * 2 : m;
+    }
+    else
+      r = n;
+  }
+
+  // Parallel bulk persist.
+  //
+  database::parallel_task::
+  ~parallel_task ()
+  {
+  }
+
+  struct database::parallel_part
+  {
+    parallel_part (): committed (false), failed (0) {}
+
+    database* db;
+    parallel_task* task;
+    bool all_or_nothing;
+
+    connection_ptr conn;
+    transaction tx;
+    details::shared_ptr<odb::exception> error;
+    details::shared_ptr<odb::exception> commit_error; // Commit/rollback.
+    bool committed;
+    size_t failed;
+  };
+
+  void* database::
+  parallel_worker (void* arg)
+  {
+    parallel_part& p (*static_cast<parallel_part*> (arg));
+
+    try
+    {
+      p.conn = p.db->connection ();
+      p.tx.reset (p.conn->begin (), false);
+      transaction::current (p.tx);
+
+      bool fatal (false);
+
+      try
+      {
+        p.task->execute ();
+      }
+      catch (const multiple_exceptions& e)
+      {
+        p.error.reset (e.clone ());
+        fatal = e.fatal ();
+      }
+
+      transaction::reset_current ();
+
+      if (!p.all_or_nothing)
+      {
+        // Record the failure to finalize the transaction separately so
+        // that it does not hide the per-object failures.
+        //
+        try
+        {
+          if (fatal)
+            p.tx.rollback ();
+          else
+          {
+            p.tx.commit ();
+            p.committed = true;
+          }
+        }
+        catch (const odb::exception& e)
+        {
+          p.commit_error.reset (e.clone ());
+        }
+        catch (...)
+        {
+          p.commit_error.reset (new parallel_part_failed);
+        }
+      }
+    }
+    catch (const odb::exception& e)
+    {
+      if (transaction::has_current ())
+        transaction::reset_current ();
+
+      p.error.reset (e.clone ());
+    }
+    catch (...)
+    {
+      // Nothing should escape the thread function.
+      //
+      if (transaction::has_current ())
+        transaction::reset_current ();
+
+      p.error.reset (new parallel_part_failed);
+    }
+
+    return 0;
+  }
+
+  // Record the failure of a part as a whole at its first position that
+  // has not failed yet so that it does not hide the per-object failures.
+  //
+  static void
+  parallel_part_failure (multiple_exceptions& mex,
+                         size_t offset,
+                         size_t size,
+                         const odb::exception& e)
+  {
+    size_t i (offset);
+    for (; i != offset + size && mex[i] != 0; ++i) ;
+
+    mex.insert (i != offset + size ? i : offset, e, true);
+  }
+
+  void database::
+  persist_parallel_ (parallel_task* const* ts,
+                     size_t n,
+                     bool aon,
+                     parallel_stats* s)
+  {
+    if (transaction::has_current ())
+      throw already_in_transaction ();
+
+    unsigned long long start (bulk_batch_now ());
+
+    // Deleting the parts rolls back any transactions that are still
+    // active.
+    //
+    struct parts_guard
+    {
+      parts_guard (parallel_part* p): p_ (p) {}
+      ~parts_guard () {delete[] p_;}
+      parallel_part* p_;
+    };
+
+    parallel_part* ps (new parallel_part[n]);
+    parts_guard pg (ps);
+
+    size_t size (0);
+    for (size_t i (0); i != n; ++i)
+    {
+      ps[i].db = this;
+      ps[i].task = ts[i];
+      ps[i].all_or_nothing = aon;
+      size += ts[i]->size;
+    }
+
+#ifndef ODB_THREADS_NONE
+    {
+      vector<details::thread*> ths;
+      ths.reserve (n);
+
+      try
+      {
+        for (size_t i (0); i != n; ++i)
+          ths.push_back (new details::thread (&parallel_worker, ps + i));
+      }
+      catch (...)
+      {
+        for (size_t i (0); i != ths.size (); ++i)
+        {
+          ths[i]->join ();
+          delete ths[i];
+        }
+
+        throw;
+      }
+
+      for (size_t i (0); i != n; ++i)
+      {
+        ths[i]->join ();
+        delete ths[i];
+      }
+    }
+#else
+    for (size_t i (0); i != n; ++i)
+      parallel_worker (ps + i);
+#endif
+
+    // Collect the failures with positions in the whole range.
+    //
+    multiple_exceptions mex (typeid (object_already_persistent));
+    mex.attempted (size);
+
+    for (size_t i (0); i != n; ++i)
+    {
+      parallel_part& p (ps[i]);
+      size_t f (mex.failed ());
+
+      if (p.error)
+      {
+        if (const multiple_exceptions* e =
+            dynamic_cast<const multiple_exceptions*> (p.error.get ()))
+        {
+          for (multiple_exceptions::iterator j (e->begin ());
+               j != e->end ();
+               ++j)
+            mex.insert (p.task->offset + j->position (),
+                        j->maybe (),
+                        j->exception (),
+                        e->fatal ());
+        }
+        else
+          mex.insert (p.task->offset, *p.error, true);
+      }
+
+      if (p.commit_error)
+        parallel_part_failure (
+          mex, p.task->offset, p.task->size, *p.commit_error);
+
+      p.failed = mex.failed () - f;
+    }
+
+    if (aon)
+    {
+      bool commit (mex.empty ());
+
+      for (size_t i (0); i != n; ++i)
+      {
+        parallel_part& p (ps[i]);
+
+        if (p.tx.finalized ())
+          continue;
+
+        try
+        {
+          if (commit)
+          {
+            p.tx.commit ();
+            p.committed = true;
+          }
+          else
+            p.tx.rollback ();
+        }
+        catch (const odb::exception& e)
+        {
+          size_t f (mex.failed ());
+          parallel_part_failure (mex, p.task->offset, p.task->size, e);
+          p.failed += mex.failed () - f;
+          commit = false;
+        }
+      }
+    }
+
+    if (s != 0)
+    {
+      s->attempted = size;
+      s->failed = mex.failed ();
+      s->committed = 0;
+
+      for (size_t i (0); i != n; ++i)
+      {
+        if (ps[i].committed)
+          s->committed += ps[i].task->size - ps[i].failed;
+      }
+
+      s->time = start != 0 ? bulk_batch_now () - start : 0;
+    }
+
+    if (!mex.empty ())
+    {
+      mex.prepare ();
+      throw mex;
+    }
+  }
+
+  // transact()
+  //
+  unsigned long long database::
+  transact_now_ ()
+  {
+    return bulk_batch_now ();
+  }
+
+  void database::
+  transact_backoff_ (const retry_policy& p, unsigned int n, retry_stats* s)
+  {
+    unsigned long d (p.initial_delay);
+
+    for (unsigned int i (0); i != n && d < p.max_delay; ++i)
+      d *= 2;
+
+    if (d > p.max_delay)
+      d = p.max_delay;
+
+    // Jitter: wait a random time between d/2 and d so that the
+    // transactions that have failed together don't all retry at the
+    // same time. The quality of the random numbers is not important.
+    //
+    if (d > 1)
+    {
+      unsigned long long x (bulk_batch_now ());
+      x ^= reinterpret_cast<size_t> (&x);
+      x = (x ^ (x >> 31) ^ n) * 2654435761UL;
+      x ^= x >> 29;
+
+      d = d - d / 2 + static_cast<unsigned long> (x % (d / 2 + 1));
+    }
+
+    if (s != 0)
+    {
+      s->retries++;
+      s->backoff += d;
+    }
+
+    if (d == 0)
+      return;
+
+#ifdef ODB_THREADS_WIN32
+    Sleep (static_cast<DWORD> (d));
+#else
+    timespec ts;
+    ts.tv_sec = static_cast<time_t> (d / 1000);
+    ts.tv_nsec = static_cast<long> (d % 1000) * 1000000L;
+
+    while (nanosleep (&ts, &ts) != 0 && errno == EINTR) ;
+#endif
+  }
 }
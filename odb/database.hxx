@@ -11,8 +11,10 @@
 
 #include <map>
 #include <string>
-#include <memory>  // std::auto_ptr, std::unique_ptr
-#include <cstddef> // std::size_t
+#include <vector>
+#include <memory>   // std::auto_ptr, std::unique_ptr
+#include <cstddef>  // std::size_t
+#include <typeinfo>
 
 #ifdef ODB_CXX11
 #  include <utility>     // std::move
@@ -27,11 +29,13 @@
 #include <odb/prepared-query.hxx>
 #include <odb/result.hxx>
 #include <odb/connection.hxx>
+#include <odb/transaction.hxx>
 #include <odb/exceptions.hxx>
 
 #include <odb/details/export.hxx>
 #include <odb/details/mutex.hxx>
 #include <odb/details/c-string.hxx>
+#include <odb/details/type-info.hxx>
 #include <odb/details/function-wrapper.hxx>
 #include <odb/details/meta/answer.hxx>
 
@@ -409,6 +413,36 @@ namespace odb
     virtual transaction_impl*
     begin () = 0;
 
+    // Begin a read-only transaction. The persist(), update(), and erase()
+    // functions throw read_only_transaction if called in such a
+    // transaction.
+    //
+    // A database runtime should override this function to start the
+    // transaction in the read-only mode or on a replica, constructing the
+    // implementation with the read-only flag set before calling start()
+    // (see transaction_impl). The default implementation calls begin()
+    // and sets the flag afterwards, which is too late for a runtime that
+    // starts the transaction (or selects the connection) in begin(). In
+    // this case the transaction is only read-only on the client side.
+    //
+    virtual transaction_impl*
+    begin_read_only ();
+
+    // Wait for the asynchronous commits (see transaction::commit_async())
+    // submitted so far to complete.
+    //
+    void
+    wait_async ();
+
+  protected:
+    // Enable asynchronous commits. The commits use the database
+    // implementation (connections, etc) so a runtime should only enable
+    // them if its destructor calls wait_async() before destroying any
+    // of it. Otherwise transaction::commit_async() commits synchronously.
+    //
+    void
+    async_commit (bool e) {async_commit_ = e;}
+
     // Connections.
     //
   public:
@@ -429,6 +463,146 @@ namespace odb
     tracer_type*
     tracer () const;
 
+    // Dynamic query ranges.
+    //
+  public:
+    // Maximum number of elements of a range bound by reference with
+    // in_range() that are passed to a single statement. Larger ranges
+    // are split into chunks (see query_base::range_chunks()). Zero (the
+    // default) means the database-specific limit is used.
+    //
+    void
+    query_range_chunk_size (std::size_t);
+
+    std::size_t
+    query_range_chunk_size () const;
+
+    // Bulk operations.
+    //
+  public:
+    // Maximum number of objects passed to the database in a single batch
+    // by the bulk persist(), update(), and erase() functions. It is always
+    // capped by the batch size the object was compiled with. Zero (the
+    // default) means use that size.
+    //
+    void
+    bulk_batch_size (std::size_t);
+
+    std::size_t
+    bulk_batch_size () const;
+
+    // Adaptive batch size. In this mode the batch size is adjusted for
+    // each object type between 1 and the above maximum based on the
+    // observed per-batch latency and failure rate. The batch size is
+    // doubled while batches complete within the target latency (in
+    // milliseconds) without failures and is halved when a batch takes
+    // longer than that or when more than a quarter of its objects fail.
+    // Note that the latency is only measured if the library is built
+    // with C++11 support; otherwise only failures are taken into account.
+    //
+    void
+    bulk_batch_adaptive (bool, unsigned long target_latency = 100);
+
+    bool
+    bulk_batch_adaptive () const;
+
+    // Parallel bulk persist. Partition the range into up to n parts and
+    // persist each part on its own connection and in its own transaction
+    // in a separate thread (or one after another if the library is built
+    // without thread support). The range must be a forward range, no
+    // transaction should be in effect, and n should not exceed the number
+    // of connections the database can open at the same time. Note also
+    // that the objects are not added to the session cache.
+    //
+    // If all_or_nothing is true, then the transactions are committed only
+    // if all the parts succeed and are rolled back otherwise. This is not
+    // atomic: if committing one of the transactions fails, then those
+    // already committed stay committed while the rest are rolled back.
+    // Otherwise, each transaction is committed on its own unless its part
+    // has failed fatally.
+    //
+    // Failures from all the parts are thrown as a single
+    // multiple_exceptions with positions in the whole range. If stats
+    // is not NULL, then it is filled in before returning or throwing.
+    //
+    struct parallel_stats
+    {
+      std::size_t attempted;   // Number of objects attempted.
+      std::size_t failed;      // Number of objects that have failed.
+      std::size_t committed;   // Number of objects committed.
+      unsigned long long time; // Elapsed time in microseconds or 0.
+
+      // Objects committed per second or 0 if the time is unknown (the
+      // time is only measured if the library is built with C++11
+      // support).
+      //
+      double
+      throughput () const
+      {
+        return time != 0 ? static_cast<double> (committed) * 1e6 / time : 0;
+      }
+    };
+
+    template <typename I>
+    void
+    persist_parallel (I begin,
+                      I end,
+                      std::size_t n,
+                      bool all_or_nothing = false,
+                      parallel_stats* stats = 0);
+
+    // Streaming bulk persist (see below).
+    //
+    template <typename T>
+    class bulk_writer;
+
+    // Transaction retry. Begin a transaction, call f() (with the
+    // transaction being current), and commit. If this fails with one of
+    // the recoverable exceptions (deadlock, timeout, or connection_lost),
+    // then roll back, wait, and retry up to max_retries times after which
+    // the exception is rethrown. Other exceptions are propagated without
+    // retrying. Note that f() should therefore have no side effects
+    // other than on the database.
+    //
+    // The wait before the n-th retry is a random value between half and
+    // all of initial_delay * 2^n milliseconds but no more than max_delay.
+    // The connection that has failed with connection_lost is marked as
+    // failed (see connection::mark_failed()) so that the connection
+    // factory does not hand it out again for the next attempt.
+    //
+    struct retry_policy
+    {
+      explicit
+      retry_policy (unsigned int max_retries_ = 5,
+                    unsigned long initial_delay_ = 10,
+                    unsigned long max_delay_ = 1000)
+          : max_retries (max_retries_),
+            initial_delay (initial_delay_),
+            max_delay (max_delay_)
+      {
+      }
+
+      unsigned int max_retries;
+      unsigned long initial_delay; // Milliseconds.
+      unsigned long max_delay;     // Milliseconds.
+    };
+
+    // If stats is not NULL, then it is filled in before returning or
+    // throwing.
+    //
+    struct retry_stats
+    {
+      unsigned int retries;       // Number of retries.
+      unsigned long long backoff; // Total wait time in milliseconds.
+      unsigned long long time;    // Elapsed time in microseconds or 0.
+    };
+
+    template <typename F>
+    void
+    transact (F f,
+              const retry_policy& = retry_policy (),
+              retry_stats* stats = 0);
+
     // Database schema version.
     //
   public:
@@ -527,11 +701,19 @@ namespace odb
 
     template <typename I, typename T, database_id DB>
     void
-    persist_ (I, I, bool, details::meta::no ptr);
+    persist_ (I, I, bool, details::meta::no ptr, details::meta::no poly);
+
+    template <typename I, typename T, database_id DB>
+    void
+    persist_ (I, I, bool, details::meta::yes ptr, details::meta::no poly);
 
     template <typename I, typename T, database_id DB>
     void
-    persist_ (I, I, bool, details::meta::yes ptr);
+    persist_ (I, I, bool, details::meta::no ptr, details::meta::yes poly);
+
+    template <typename I, typename T, database_id DB>
+    void
+    persist_ (I, I, bool, details::meta::yes ptr, details::meta::yes poly);
 
     template <typename T, database_id DB>
     typename object_traits<T>::pointer_type
@@ -569,6 +751,14 @@ namespace odb
     void
     update_ (I, I, bool);
 
+    template <typename I, typename P, database_id DB>
+    void
+    update_ (I, I, bool, details::meta::no poly);
+
+    template <typename I, typename P, database_id DB>
+    void
+    update_ (I, I, bool, details::meta::yes poly);
+
     template <typename T, database_id DB>
     void
     update_ (const T&, const section&);
@@ -587,12 +777,24 @@ namespace odb
 
     template <typename I, typename T, database_id DB>
     void
-    erase_id_ (I, I, bool);
+    erase_id_ (I, I, bool, details::meta::no poly);
+
+    template <typename I, typename T, database_id DB>
+    void
+    erase_id_ (I, I, bool, details::meta::yes poly);
 
     template <typename I, database_id DB>
     void
     erase_object_ (I, I, bool);
 
+    template <typename I, typename P, database_id DB>
+    void
+    erase_object_ (I, I, bool, details::meta::no poly);
+
+    template <typename I, typename P, database_id DB>
+    void
+    erase_object_ (I, I, bool, details::meta::yes poly);
+
     template <typename T, database_id DB, typename Q>
     typename result<T>::pointer_type
     query_one_ (const Q&);
@@ -610,6 +812,110 @@ namespace odb
               class_kind kind = class_traits<T>::kind>
     struct query_;
 
+    // Bulk operation batch sizing.
+    //
+    struct bulk_batch
+    {
+      std::size_t size;         // Number of objects in this batch.
+      unsigned long long start; // Start time in microseconds or 0.
+    };
+
+    bulk_batch
+    bulk_batch_begin (const std::type_info&, std::size_t max);
+
+    // The n argument is the number of objects actually in the batch
+    // (which can be less than the batch size at the end of the range).
+    //
+    void
+    bulk_batch_end (const std::type_info&,
+                    const bulk_batch&,
+                    std::size_t n,
+                    std::size_t max,
+                    std::size_t failed);
+
+    bulk_batch
+    bulk_batch_begin_ (const std::type_info&, std::size_t max);
+
+    void
+    bulk_batch_end_ (const std::type_info&,
+                     const bulk_batch&,
+                     std::size_t n,
+                     std::size_t max,
+                     std::size_t failed);
+
+    // Parallel bulk persist.
+    //
+    struct parallel_task
+    {
+      virtual
+      ~parallel_task ();
+
+      virtual void
+      execute () = 0;
+
+      std::size_t offset; // Position of the part in the range.
+      std::size_t size;   // Number of objects in the part.
+    };
+
+    template <typename I>
+    struct parallel_persist_task;
+
+    struct parallel_part;
+
+    static void*
+    parallel_worker (void*);
+
+    void
+    persist_parallel_ (parallel_task* const*,
+                       std::size_t n,
+                       bool all_or_nothing,
+                       parallel_stats*);
+
+    // Throw read_only_transaction if there is a current transaction and
+    // it is read-only.
+    //
+    static void
+    check_writable_ ();
+
+    // Transaction retry. The time is in microseconds and is 0 if the
+    // library is built without C++11 support.
+    //
+    static unsigned long long
+    transact_now_ ();
+
+    static void
+    transact_backoff_ (const retry_policy&,
+                       unsigned int attempt,
+                       retry_stats*);
+
+    // Asynchronous commit (see transaction::commit_async()). The tasks
+    // are executed in the order of submission by a background thread
+    // which is started on the first submission. Public only for
+    // transaction.
+    //
+  public:
+    struct async_task
+    {
+      virtual
+      ~async_task ();
+
+      // Should not throw.
+      //
+      virtual void
+      execute () = 0;
+    };
+
+    // Take ownership of the task.
+    //
+    void
+    async_ (async_task*);
+
+  private:
+    struct async_committer;
+
+    static void*
+    async_worker (void*);
+
   protected:
     typedef
     std::map<const char*, query_factory_wrapper, details::c_string_comparator>
@@ -619,13 +925,124 @@ namespace odb
 
     database_id id_;
     tracer_type* tracer_;
+    std::size_t query_range_chunk_size_;
     query_factory_map query_factory_map_;
 
+    typedef
+    std::map<const std::type_info*,
+             std::size_t,
+             details::type_info_comparator> bulk_batch_map;
+
+    std::size_t bulk_batch_size_;
+    bool bulk_batch_adaptive_;
+    unsigned long bulk_batch_latency_;
+    bulk_batch_map bulk_batch_map_;
+    details::mutex bulk_batch_mutex_;
+
+    bool async_commit_;
+    async_committer* async_committer_;
+    details::mutex async_mutex_;
+
     mutable details::mutex mutex_;
     mutable schema_version_map schema_version_map_;
     std::string schema_version_table_;
     unsigned int schema_version_seq_;
   };
+
+  // Accept objects one at a time and persist them in batches with bulk
+  // persist() as each batch fills up. The writer keeps pointers to the
+  // objects so each object must remain valid until the batch containing
+  // it has been persisted, that is, until pending() is 0 (which is also
+  // the case after flush() and close()). Only then can the object be
+  // destroyed or reused. As with persist(), the auto-assigned ids are
+  // set in the objects and the objects are added to the session cache,
+  // if a session is in effect.
+  //
+  template <typename T>
+  class database::bulk_writer
+  {
+  public:
+    typedef T object_type;
+
+    // Called when some objects in a batch have failed. The objects are
+    // the batch (the exception positions are relative to it) and offset
+    // is the number of objects written before the batch. If there is no
+    // callback, or if the failure is fatal, the exception is rethrown.
+    //
+    typedef void (*failure_callback_type) (const multiple_exceptions&,
+                                           T* const* objects,
+                                           std::size_t n,
+                                           std::size_t offset,
+                                           void* data);
+
+    // If commit_batches is not zero, then the writer starts its own
+    // transaction and commits it every commit_batches batches as well
+    // as in close(). Otherwise, the objects are persisted in the current
+    // transaction. If batch is zero, then the batch size the object was
+    // compiled with is used.
+    //
+    explicit
+    bulk_writer (database&,
+                 std::size_t commit_batches = 0,
+                 std::size_t batch = 0);
+
+    // Objects that have not been flushed are discarded and the writer's
+    // transaction, if still active, is rolled back.
+    //
+    ~bulk_writer ();
+
+    void
+    failure_callback (failure_callback_type, void* data = 0);
+
+    void
+    write (T&);
+
+    // Persist the objects written so far, even if the batch is not full.
+    //
+    void
+    flush ();
+
+    // Flush and commit the writer's transaction, if any.
+    //
+    void
+    close ();
+
+    // The number of objects persisted (including those that have failed),
+    // the number of objects that have failed, and the number of batches.
+    //
+    std::size_t
+    written () const {return written_;}
+
+    std::size_t
+    failed () const {return failed_;}
+
+    std::size_t
+    batches () const {return batches_;}
+
+    // The number of objects written but not yet persisted.
+    //
+    std::size_t
+    pending () const {return buffer_.size ();}
+
+  private:
+    bulk_writer (const bulk_writer&);
+    bulk_writer& operator= (const bulk_writer&);
+
+  private:
+    database& db_;
+    std::size_t commit_batches_;
+    std::size_t batch_;
+    failure_callback_type callback_;
+    void* callback_data_;
+
+    std::vector<T*> buffer_;
+    transaction transaction_;
+    std::size_t pending_; // Batches since the last commit.
+
+    std::size_t written_;
+    std::size_t failed_;
+    std::size_t batches_;
+  };
 }
 
 #include <odb/database.ixx>
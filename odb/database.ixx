@@ -71,9 +71,29 @@ namespace odb
       return pointer_traits<P<T, A1> >::get_ref (p);}
   };
 
+  template <typename T, bool = object_traits<T>::polymorphic>
+  struct object_polymorphic_traits
+  {
+    typedef details::meta::no result_type;
+  };
+
+  template <typename T>
+  struct object_polymorphic_traits<T, true>
+  {
+    typedef details::meta::yes result_type;
+  };
+
   inline database::
   database (database_id id)
-      : id_ (id), tracer_ (0), schema_version_seq_ (1)
+      : id_ (id),
+        tracer_ (0),
+        query_range_chunk_size_ (0),
+        bulk_batch_size_ (0),
+        bulk_batch_adaptive_ (false),
+        bulk_batch_latency_ (100),
+        async_commit_ (false),
+        async_committer_ (0),
+        schema_version_seq_ (1)
   {
   }
 
@@ -153,6 +173,71 @@ namespace odb
     return tracer_;
   }
 
+  inline void database::
+  query_range_chunk_size (std::size_t n)
+  {
+    query_range_chunk_size_ = n;
+  }
+
+  inline std::size_t database::
+  query_range_chunk_size () const
+  {
+    return query_range_chunk_size_;
+  }
+
+  inline void database::
+  bulk_batch_size (std::size_t n)
+  {
+    bulk_batch_size_ = n;
+  }
+
+  inline std::size_t database::
+  bulk_batch_size () const
+  {
+    return bulk_batch_size_;
+  }
+
+  inline bool database::
+  bulk_batch_adaptive () const
+  {
+    return bulk_batch_adaptive_;
+  }
+
+  inline database::bulk_batch database::
+  bulk_batch_begin (const std::type_info& ti, std::size_t max)
+  {
+    if (bulk_batch_adaptive_)
+      return bulk_batch_begin_ (ti, max);
+
+    bulk_batch r;
+    r.size = bulk_batch_size_ != 0 && bulk_batch_size_ < max
+      ? bulk_batch_size_
+      : max;
+    r.start = 0;
+    return r;
+  }
+
+  inline void database::
+  bulk_batch_end (const std::type_info& ti,
+                  const bulk_batch& b,
+                  std::size_t n,
+                  std::size_t max,
+                  std::size_t failed)
+  {
+    if (bulk_batch_adaptive_)
+      bulk_batch_end_ (ti, b, n, max, failed);
+  }
+
+  inline void database::
+  check_writable_ ()
+  {
+    // Leave reporting the absence of a transaction to the operation
+    // itself.
+    //
+    if (transaction::has_current () && transaction::current ().read_only ())
+      throw read_only_transaction ();
+  }
+
   template <typename T>
   inline typename object_traits<T>::id_type database::
   persist (T& obj)
@@ -503,7 +588,13 @@ namespace odb
   inline void database::
   erase (I idb, I ide, bool cont)
   {
-    erase_id_<I, T, id_common> (idb, ide, cont);
+    check_writable_ ();
+
+    erase_id_<I, T, id_common> (
+      idb,
+      ide,
+      cont,
+      typename object_polymorphic_traits<T>::result_type ());
   }
 
   template <typename I>
@@ -544,6 +635,8 @@ namespace odb
   inline unsigned long long database::
   erase_query (const odb::query<T>& q)
   {
+    check_writable_ ();
+
     // T is always object_type.
     //
     return object_traits_impl<T, id_common>::erase_query (*this, q);
@@ -724,6 +817,8 @@ namespace odb
   inline void database::
   persist_ (I b, I e, bool cont)
   {
+    check_writable_ ();
+
     // Sun CC with non-standard STL does not have iterator_traits.
     //
 #ifndef _RWSTD_NO_CLASS_PARTIAL_SPEC
@@ -735,9 +830,76 @@ namespace odb
 #endif
 
     typedef object_pointer_traits<value_type> opt;
+    typedef typename opt::object_type object_type;
 
-    persist_<I, typename opt::object_type, id_common> (
-      b, e, cont, typename opt::result_type ());
+    persist_<I, object_type, id_common> (
+      b,
+      e,
+      cont,
+      typename opt::result_type (),
+      typename object_polymorphic_traits<object_type>::result_type ());
+  }
+
+  template <typename I, database_id DB>
+  inline void database::
+  update_ (I b, I e, bool cont)
+  {
+    check_writable_ ();
+
+    // Sun CC with non-standard STL does not have iterator_traits.
+    //
+#ifndef _RWSTD_NO_CLASS_PARTIAL_SPEC
+    typedef typename std::iterator_traits<I>::value_type value_type;
+#else
+    // Assume iterator is just a pointer.
+    //
+    typedef typename object_pointer_traits<I>::object_type value_type;
+#endif
+
+    // object_pointer_traits<T>::object_type can be const.
+    //
+    typedef object_pointer_traits<value_type> opt;
+
+    typedef
+    typename object_traits<typename opt::object_type>::object_type
+    object_type;
+
+    update_<I, opt, DB> (
+      b,
+      e,
+      cont,
+      typename object_polymorphic_traits<object_type>::result_type ());
+  }
+
+  template <typename I, database_id DB>
+  inline void database::
+  erase_object_ (I b, I e, bool cont)
+  {
+    check_writable_ ();
+
+    // Sun CC with non-standard STL does not have iterator_traits.
+    //
+#ifndef _RWSTD_NO_CLASS_PARTIAL_SPEC
+    typedef typename std::iterator_traits<I>::value_type value_type;
+#else
+    // Assume iterator is just a pointer.
+    //
+    typedef typename object_pointer_traits<I>::object_type value_type;
+#endif
+
+    // object_pointer_traits<T>::object_type can be const.
+    //
+    typedef object_pointer_traits<value_type> opt;
+
+    typedef
+    typename object_traits<typename opt::object_type>::object_type
+    object_type;
+
+    erase_object_<I, opt, DB> (
+      b,
+      e,
+      cont,
+      typename object_polymorphic_traits<object_type>::result_type ());
   }
 
   template <typename T, database_id DB>
@@ -766,6 +928,8 @@ namespace odb
   inline void database::
   update_ (T& obj)
   {
+    check_writable_ ();
+
     // T can be const T while object_type will always be T.
     //
     typedef typename object_traits<T>::object_type object_type;
@@ -780,6 +944,8 @@ namespace odb
   inline void database::
   update_ (const typename object_traits<T>::pointer_type& pobj)
   {
+    check_writable_ ();
+
     // T can be const T while object_type will always be T.
     //
     typedef typename object_traits<T>::object_type object_type;
@@ -797,6 +963,8 @@ namespace odb
   inline void database::
   erase_ (const typename object_traits<T>::id_type& id)
   {
+    check_writable_ ();
+
     // T is always object_type.
     //
     object_traits_impl<T, DB>::erase (*this, id);
@@ -806,6 +974,8 @@ namespace odb
   inline void database::
   erase_ (T& obj)
   {
+    check_writable_ ();
+
     // T can be const T while object_type will always be T.
     //
     typedef typename object_traits<T>::object_type object_type;
@@ -2,10 +2,14 @@
 // copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
 // license   : GNU GPL v2; see accompanying LICENSE file
 
+#include <vector>
+#include <iterator> // std::distance, std::advance
+
 #include <odb/section.hxx>
 #include <odb/exceptions.hxx>
 #include <odb/no-op-cache-traits.hxx>
 #include <odb/pointer-traits.hxx>
+#include <odb/polymorphic-map.hxx>
 
 namespace odb
 {
@@ -30,6 +34,8 @@ namespace odb
   typename object_traits<T>::id_type database::
   persist_ (T& obj)
   {
+    check_writable_ ();
+
     // T can be const T while object_type will always be T.
     //
     typedef typename object_traits<T>::object_type object_type;
@@ -50,6 +56,8 @@ namespace odb
   typename object_traits<T>::id_type database::
   persist_ (const typename object_traits<T>::pointer_type& pobj)
   {
+    check_writable_ ();
+
     // T can be const T while object_type will always be T.
     //
     typedef typename object_traits<T>::object_type object_type;
@@ -77,7 +85,11 @@ namespace odb
 
   template <typename I, typename T, database_id DB>
   void database::
-  persist_ (I b, I e, bool cont, details::meta::no /*ptr*/)
+  persist_ (I b,
+            I e,
+            bool cont,
+            details::meta::no /*ptr*/,
+            details::meta::no /*poly*/)
   {
     // T can be const T while object_type will always be T.
     //
@@ -89,10 +101,13 @@ namespace odb
     {
       while (b != e && (cont || mex.empty ()))
       {
-        std::size_t n (0);
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), object_traits::batch));
+
+        std::size_t n (0), f (mex.failed ());
         T* a[object_traits::batch]; // T instead of persist_type for cache.
 
-        for (; b != e && n < object_traits::batch; ++n)
+        for (; b != e && n < bb.size; ++n)
         {
           // Compiler error pointing here? Perhaps the passed range is
           // of const objects?
@@ -111,6 +126,12 @@ namespace odb
           n,
           mex);
 
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        object_traits::batch,
+                        mex.failed () - f);
+
         if (mex.fatal ())
           break;
 
@@ -165,7 +186,11 @@ namespace odb
 
   template <typename I, typename T, database_id DB>
   void database::
-  persist_ (I b, I e, bool cont, details::meta::yes /*ptr*/)
+  persist_ (I b,
+            I e,
+            bool cont,
+            details::meta::yes /*ptr*/,
+            details::meta::no /*poly*/)
   {
     // T can be const T while object_type will always be T.
     //
@@ -179,11 +204,14 @@ namespace odb
     {
       while (b != e && (cont || mex.empty ()))
       {
-        std::size_t n (0);
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), object_traits::batch));
+
+        std::size_t n (0), f (mex.failed ());
         typename persist_type<object_type>::type* a[object_traits::batch];
         pointer_copy<pointer_type> p[object_traits::batch];
 
-        for (; b != e && n < object_traits::batch; ++n)
+        for (; b != e && n < bb.size; ++n)
         {
           p[n].assign (*b++);
           a[n] = &pointer_traits<pointer_type>::get_ref (*p[n].ref);
@@ -194,6 +222,175 @@ namespace odb
         //
         object_traits::persist (*this, a, n, mex);
 
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        object_traits::batch,
+                        mex.failed () - f);
+
+        if (mex.fatal ())
+          break;
+
+        for (std::size_t i (0); i < n; ++i)
+        {
+          if (mex[i] != 0) // Don't cache objects that have failed.
+            continue;
+
+          mex.current (i); // Set position in case the below code throws.
+
+          // Get the canonical object pointer and insert it into object cache.
+          //
+          typename object_traits::pointer_cache_traits::position_type pos (
+            object_traits::pointer_cache_traits::insert (
+              *this, pointer_cache_type<pointer_type>::convert (*p[i].ref)));
+
+          object_traits::pointer_cache_traits::persist (pos);
+        }
+
+        mex.delta (n);
+      }
+    }
+    catch (const odb::exception& ex)
+    {
+      mex.insert (ex, true);
+    }
+
+    if (!mex.empty ())
+    {
+      mex.prepare ();
+      throw mex;
+    }
+  }
+
+  template <typename I, typename T, database_id DB>
+  void database::
+  persist_ (I b,
+            I e,
+            bool cont,
+            details::meta::no /*ptr*/,
+            details::meta::yes /*poly*/)
+  {
+    // T can be const T while object_type will always be T.
+    //
+    typedef typename object_traits<T>::object_type object_type;
+    typedef object_traits_impl<object_type, DB> object_traits;
+    typedef typename object_traits::root_type root_type;
+    typedef polymorphic_concrete_info<root_type> info_type;
+
+    const std::type_info& ce (typeid (object_already_persistent));
+    multiple_exceptions mex (ce);
+    try
+    {
+      while (b != e && (cont || mex.empty ()))
+      {
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), polymorphic_batch));
+
+        std::size_t n (0), f (mex.failed ());
+        T* a[polymorphic_batch]; // T instead of persist_type for cache.
+        const root_type* r[polymorphic_batch];
+
+        for (; b != e && n < bb.size; ++n)
+        {
+          // Compiler error pointing here? Perhaps the passed range is
+          // of const objects?
+          //
+          typename persist_type<object_type>::type* p (&(*b++));
+
+          a[n] = const_cast<T*> (p);
+          r[n] = a[n];
+        }
+
+        // Persist by the dynamic type (see polymorphic_bulk()).
+        //
+        polymorphic_bulk<root_type, DB> (
+          info_type::call_persist, *this, r, n, ce, mex);
+
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        polymorphic_batch,
+                        mex.failed () - f);
+
+        if (mex.fatal ())
+          break;
+
+        for (std::size_t i (0); i < n; ++i)
+        {
+          if (mex[i] != 0) // Don't cache objects that have failed.
+            continue;
+
+          mex.current (i); // Set position in case the below code throws.
+
+          typename object_traits::reference_cache_traits::position_type p (
+            object_traits::reference_cache_traits::insert (
+              *this, reference_cache_type<T>::convert (*a[i])));
+
+          object_traits::reference_cache_traits::persist (p);
+        }
+
+        mex.delta (n);
+      }
+    }
+    catch (const odb::exception& ex)
+    {
+      mex.insert (ex, true);
+    }
+
+    if (!mex.empty ())
+    {
+      mex.prepare ();
+      throw mex;
+    }
+  }
+
+  template <typename I, typename T, database_id DB>
+  void database::
+  persist_ (I b,
+            I e,
+            bool cont,
+            details::meta::yes /*ptr*/,
+            details::meta::yes /*poly*/)
+  {
+    // T can be const T while object_type will always be T.
+    //
+    typedef typename object_traits<T>::object_type object_type;
+    typedef typename object_traits<T>::pointer_type pointer_type;
+
+    typedef object_traits_impl<object_type, DB> object_traits;
+    typedef typename object_traits::root_type root_type;
+    typedef polymorphic_concrete_info<root_type> info_type;
+
+    const std::type_info& ce (typeid (object_already_persistent));
+    multiple_exceptions mex (ce);
+    try
+    {
+      while (b != e && (cont || mex.empty ()))
+      {
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), polymorphic_batch));
+
+        std::size_t n (0), f (mex.failed ());
+        const root_type* r[polymorphic_batch];
+        pointer_copy<pointer_type> p[polymorphic_batch];
+
+        for (; b != e && n < bb.size; ++n)
+        {
+          p[n].assign (*b++);
+          r[n] = &pointer_traits<pointer_type>::get_ref (*p[n].ref);
+        }
+
+        // Persist by the dynamic type (see polymorphic_bulk()).
+        //
+        polymorphic_bulk<root_type, DB> (
+          info_type::call_persist, *this, r, n, ce, mex);
+
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        polymorphic_batch,
+                        mex.failed () - f);
+
         if (mex.fatal ())
           break;
 
@@ -277,23 +474,11 @@ namespace odb
       throw object_not_persistent ();
   }
 
-  template <typename I, database_id DB>
+  template <typename I, typename P, database_id DB>
   void database::
-  update_ (I b, I e, bool cont)
+  update_ (I b, I e, bool cont, details::meta::no /*poly*/)
   {
-    // Sun CC with non-standard STL does not have iterator_traits.
-    //
-#ifndef _RWSTD_NO_CLASS_PARTIAL_SPEC
-    typedef typename std::iterator_traits<I>::value_type value_type;
-#else
-    // Assume iterator is just a pointer.
-    //
-    typedef typename object_pointer_traits<I>::object_type value_type;
-#endif
-
-    // object_pointer_traits<T>::object_type can be const.
-    //
-    typedef object_pointer_traits<value_type> opt;
+    typedef P opt;
 
     typedef
     typename object_traits<typename opt::object_type>::object_type
@@ -310,10 +495,13 @@ namespace odb
     {
       while (b != e && (cont || mex.empty ()))
       {
-        std::size_t n (0);
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), object_traits::batch));
+
+        std::size_t n (0), f (mex.failed ());
         const object_type* a[object_traits::batch];
 
-        for (; b != e && n < object_traits::batch; ++n)
+        for (; b != e && n < bb.size; ++n)
           a[n] = &opt::get_ref (*b++);
 
         // Compiler error pointing here? Perhaps the object or the
@@ -321,6 +509,75 @@ namespace odb
         //
         object_traits::update (*this, a, n, mex);
 
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        object_traits::batch,
+                        mex.failed () - f);
+
+        if (mex.fatal ())
+          break;
+
+        mex.delta (n);
+      }
+    }
+    catch (const odb::exception& ex)
+    {
+      mex.insert (ex, true);
+    }
+
+    if (!mex.empty ())
+    {
+      mex.prepare ();
+      throw mex;
+    }
+  }
+
+  template <typename I, typename P, database_id DB>
+  void database::
+  update_ (I b, I e, bool cont, details::meta::yes /*poly*/)
+  {
+    typedef P opt;
+
+    typedef
+    typename object_traits<typename opt::object_type>::object_type
+    object_type;
+
+    typedef object_traits_impl<object_type, DB> object_traits;
+    typedef typename object_traits::root_type root_type;
+    typedef object_traits_impl<root_type, DB> root_traits;
+    typedef polymorphic_concrete_info<root_type> info_type;
+
+    const std::type_info& ce (
+      root_traits::managed_optimistic_column_count == 0
+      ? typeid (object_not_persistent)
+      : typeid (object_changed));
+
+    multiple_exceptions mex (ce);
+    try
+    {
+      while (b != e && (cont || mex.empty ()))
+      {
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), polymorphic_batch));
+
+        std::size_t n (0), f (mex.failed ());
+        const root_type* a[polymorphic_batch];
+
+        for (; b != e && n < bb.size; ++n)
+          a[n] = &opt::get_ref (*b++);
+
+        // Update by the dynamic type (see polymorphic_bulk()).
+        //
+        polymorphic_bulk<root_type, DB> (
+          info_type::call_update, *this, a, n, ce, mex);
+
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        polymorphic_batch,
+                        mex.failed () - f);
+
         if (mex.fatal ())
           break;
 
@@ -348,6 +605,9 @@ namespace odb
 
     transaction& t (transaction::current ());
 
+    if (t.read_only ())
+      throw read_only_transaction ();
+
     // T is always object_type.
     //
     if (object_traits_impl<T, DB>::update (t.connection (), obj, s))
@@ -361,7 +621,7 @@ namespace odb
 
   template <typename I, typename T, database_id DB>
   void database::
-  erase_id_ (I b, I e, bool cont)
+  erase_id_ (I b, I e, bool cont, details::meta::no /*poly*/)
   {
     // T is explicitly specified by the caller, so assume it is object type.
     //
@@ -374,10 +634,13 @@ namespace odb
     {
       while (b != e && (cont || mex.empty ()))
       {
-        std::size_t n (0);
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), object_traits::batch));
+
+        std::size_t n (0), f (mex.failed ());
         const id_type* a[object_traits::batch];
 
-        for (; b != e && n < object_traits::batch; ++n)
+        for (; b != e && n < bb.size; ++n)
           // Compiler error pointing here? Perhaps the object id type
           // and the range element type don't match?
           //
@@ -388,6 +651,12 @@ namespace odb
         //
         object_traits::erase (*this, a, n, mex);
 
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        object_traits::batch,
+                        mex.failed () - f);
+
         if (mex.fatal ())
           break;
 
@@ -406,23 +675,56 @@ namespace odb
     }
   }
 
-  template <typename I, database_id DB>
+  template <typename I, typename T, database_id DB>
   void database::
-  erase_object_ (I b, I e, bool cont)
+  erase_id_ (I b, I e, bool cont, details::meta::yes /*poly*/)
   {
-    // Sun CC with non-standard STL does not have iterator_traits.
-    //
-#ifndef _RWSTD_NO_CLASS_PARTIAL_SPEC
-    typedef typename std::iterator_traits<I>::value_type value_type;
-#else
-    // Assume iterator is just a pointer.
+    // T is explicitly specified by the caller, so assume it is object type.
     //
-    typedef typename object_pointer_traits<I>::object_type value_type;
-#endif
+    typedef T object_type;
+    typedef object_traits_impl<object_type, DB> object_traits;
 
-    // object_pointer_traits<T>::object_type can be const.
+    // The dynamic type of an object cannot be determined from its id
+    // without loading it so erase the objects one at a time.
     //
-    typedef object_pointer_traits<value_type> opt;
+    multiple_exceptions mex (typeid (object_not_persistent));
+    try
+    {
+      for (std::size_t n (0); b != e && (cont || mex.empty ()); ++n)
+      {
+        mex.current (n); // Set position in case the below code throws.
+        mex.attempted (n + 1);
+
+        try
+        {
+          // Compiler error pointing here? Perhaps the object id type
+          // and the range element type don't match?
+          //
+          object_traits::erase (*this, *b++);
+        }
+        catch (const object_not_persistent& ex)
+        {
+          mex.insert (ex);
+        }
+      }
+    }
+    catch (const odb::exception& ex)
+    {
+      mex.insert (ex, true);
+    }
+
+    if (!mex.empty ())
+    {
+      mex.prepare ();
+      throw mex;
+    }
+  }
+
+  template <typename I, typename P, database_id DB>
+  void database::
+  erase_object_ (I b, I e, bool cont, details::meta::no /*poly*/)
+  {
+    typedef P opt;
 
     typedef
     typename object_traits<typename opt::object_type>::object_type
@@ -439,10 +741,13 @@ namespace odb
     {
       while (b != e && (cont || mex.empty ()))
       {
-        std::size_t n (0);
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), object_traits::batch));
+
+        std::size_t n (0), f (mex.failed ());
         const object_type* a[object_traits::batch];
 
-        for (; b != e && n < object_traits::batch; ++n)
+        for (; b != e && n < bb.size; ++n)
           a[n] = &opt::get_ref (*b++);
 
         // Compiler error pointing here? Perhaps the object or the
@@ -450,6 +755,12 @@ namespace odb
         //
         object_traits::erase (*this, a, n, mex);
 
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        object_traits::batch,
+                        mex.failed () - f);
+
         if (mex.fatal ())
           break;
 
@@ -468,6 +779,289 @@ namespace odb
     }
   }
 
+  template <typename I, typename P, database_id DB>
+  void database::
+  erase_object_ (I b, I e, bool cont, details::meta::yes /*poly*/)
+  {
+    typedef P opt;
+
+    typedef
+    typename object_traits<typename opt::object_type>::object_type
+    object_type;
+
+    typedef object_traits_impl<object_type, DB> object_traits;
+    typedef typename object_traits::root_type root_type;
+    typedef object_traits_impl<root_type, DB> root_traits;
+    typedef polymorphic_concrete_info<root_type> info_type;
+
+    const std::type_info& ce (
+      root_traits::managed_optimistic_column_count == 0
+      ? typeid (object_not_persistent)
+      : typeid (object_changed));
+
+    multiple_exceptions mex (ce);
+    try
+    {
+      while (b != e && (cont || mex.empty ()))
+      {
+        bulk_batch bb (
+          bulk_batch_begin (typeid (object_type), polymorphic_batch));
+
+        std::size_t n (0), f (mex.failed ());
+        const root_type* a[polymorphic_batch];
+
+        for (; b != e && n < bb.size; ++n)
+          a[n] = &opt::get_ref (*b++);
+
+        // Erase by the dynamic type (see polymorphic_bulk()).
+        //
+        polymorphic_bulk<root_type, DB> (
+          info_type::call_erase, *this, a, n, ce, mex);
+
+        bulk_batch_end (typeid (object_type),
+                        bb,
+                        n,
+                        polymorphic_batch,
+                        mex.failed () - f);
+
+        if (mex.fatal ())
+          break;
+
+        mex.delta (n);
+      }
+    }
+    catch (const odb::exception& ex)
+    {
+      mex.insert (ex, true);
+    }
+
+    if (!mex.empty ())
+    {
+      mex.prepare ();
+      throw mex;
+    }
+  }
+
+  template <typename I>
+  struct database::parallel_persist_task: database::parallel_task
+  {
+    parallel_persist_task (database& db, I b, I e)
+        : db_ (&db), b_ (b), e_ (e) {}
+
+    virtual void
+    execute ()
+    {
+      db_->persist (b_, e_);
+    }
+
+  private:
+    database* db_;
+    I b_;
+    I e_;
+  };
+
+  template <typename I>
+  void database::
+  persist_parallel (I b, I e, std::size_t n, bool aon, parallel_stats* s)
+  {
+    typedef parallel_persist_task<I> task_type;
+
+    std::size_t size (static_cast<std::size_t> (std::distance (b, e)));
+
+    if (n == 0)
+      n = 1;
+
+    if (n > size)
+      n = size;
+
+    std::vector<task_type> ts;
+    std::vector<parallel_task*> ps;
+    ts.reserve (n);
+    ps.reserve (n);
+
+    // Split the range into n parts that differ in size by at most one.
+    //
+    for (std::size_t i (0), o (0); i != n; ++i)
+    {
+      std::size_t m (size / n + (i < size % n ? 1 : 0));
+
+      I pe (b);
+      std::advance (pe, m);
+
+      ts.push_back (task_type (*this, b, pe));
+      ts.back ().offset = o;
+      ts.back ().size = m;
+      ps.push_back (&ts.back ());
+
+      b = pe;
+      o += m;
+    }
+
+    persist_parallel_ (n != 0 ? &ps[0] : 0, n, aon, s);
+  }
+
+  // transact()
+  //
+  template <typename F>
+  void database::
+  transact (F f, const retry_policy& p, retry_stats* s)
+  {
+    unsigned long long start (0);
+
+    if (s != 0)
+    {
+      s->retries = 0;
+      s->backoff = 0;
+      s->time = 0;
+      start = transact_now_ ();
+    }
+
+    for (unsigned int n (0);; ++n)
+    {
+      try
+      {
+        transaction t (begin ());
+
+        try
+        {
+          f ();
+          t.commit ();
+        }
+        catch (const connection_lost&)
+        {
+          t.connection ().mark_failed ();
+          throw;
+        }
+
+        break;
+      }
+      catch (const recoverable&)
+      {
+        if (n == p.max_retries)
+        {
+          if (start != 0)
+            s->time = transact_now_ () - start;
+
+          throw;
+        }
+
+        transact_backoff_ (p, n, s);
+      }
+    }
+
+    if (start != 0)
+      s->time = transact_now_ () - start;
+  }
+
+  // bulk_writer
+  //
+  template <typename T>
+  database::bulk_writer<T>::
+  bulk_writer (database& db, std::size_t commit_batches, std::size_t batch)
+      : db_ (db),
+        commit_batches_ (commit_batches),
+        batch_ (batch != 0
+                ? batch
+                : object_traits_impl<T, id_common>::batch),
+        callback_ (0),
+        callback_data_ (0),
+        pending_ (0),
+        written_ (0),
+        failed_ (0),
+        batches_ (0)
+  {
+    buffer_.reserve (batch_);
+  }
+
+  template <typename T>
+  database::bulk_writer<T>::
+  ~bulk_writer ()
+  {
+    // The transaction destructor rolls back if it is still active.
+  }
+
+  template <typename T>
+  void database::bulk_writer<T>::
+  failure_callback (failure_callback_type c, void* data)
+  {
+    callback_ = c;
+    callback_data_ = data;
+  }
+
+  template <typename T>
+  void database::bulk_writer<T>::
+  write (T& obj)
+  {
+    buffer_.push_back (&obj);
+
+    if (buffer_.size () >= batch_)
+      flush ();
+  }
+
+  template <typename T>
+  void database::bulk_writer<T>::
+  flush ()
+  {
+    if (buffer_.empty ())
+      return;
+
+    if (commit_batches_ != 0 && transaction_.finalized ())
+      transaction_.reset (db_.begin ());
+
+    std::size_t n (buffer_.size ()), offset (written_);
+
+    written_ += n;
+    batches_++;
+
+    try
+    {
+      db_.persist (buffer_.begin (), buffer_.end ());
+    }
+    catch (const multiple_exceptions& e)
+    {
+      failed_ += e.failed ();
+
+      if (callback_ != 0)
+        callback_ (e, &buffer_[0], n, offset, callback_data_);
+
+      if (callback_ == 0 || e.fatal ())
+      {
+        buffer_.clear ();
+
+        // After a fatal failure the transaction must be rolled back.
+        //
+        if (e.fatal () && !transaction_.finalized ())
+        {
+          pending_ = 0;
+          transaction_.rollback ();
+        }
+
+        throw;
+      }
+    }
+
+    buffer_.clear ();
+
+    if (commit_batches_ != 0 && ++pending_ == commit_batches_)
+    {
+      pending_ = 0;
+      transaction_.commit ();
+    }
+  }
+
+  template <typename T>
+  void database::bulk_writer<T>::
+  close ()
+  {
+    flush ();
+
+    if (!transaction_.finalized ())
+    {
+      pending_ = 0;
+      transaction_.commit ();
+    }
+  }
+
   template <typename T, database_id DB>
   struct database::query_<T, DB, class_object>
   {
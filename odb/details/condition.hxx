@@ -25,6 +25,9 @@ namespace odb
       void
       signal () {}
 
+      void
+      broadcast () {}
+
       void
       wait () {}
 
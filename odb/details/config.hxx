@@ -39,6 +39,19 @@
 #    define ODB_CXX11_FUNCTION_TEMPLATE_DEFAULT_ARGUMENT
 #    define ODB_CXX11_VARIADIC_TEMPLATE
 #    define ODB_CXX11_INITIALIZER_LIST
+// GCC supports thread_local from 4.8, Clang -- 3.3.
+//
+#    if defined(__clang__)
+#      if __has_feature(cxx_thread_local)
+#        define ODB_CXX11_THREAD_LOCAL
+#      endif
+#    elif defined(__GNUC__)
+#      if (__GNUC__ == 4 && __GNUC_MINOR__ >= 8) || __GNUC__ > 4
+#        define ODB_CXX11_THREAD_LOCAL
+#      endif
+#    else
+#      define ODB_CXX11_THREAD_LOCAL
+#    endif
 // GCC supports strongly typed enums from 4.4 (forward -- 4.6),
 // Clang -- 2.9 (3.1).
 //
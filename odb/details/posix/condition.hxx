@@ -25,6 +25,11 @@ namespace odb
       void
       signal ();
 
+      // Wake up all the waiting threads.
+      //
+      void
+      broadcast ();
+
       void
       wait ();
 
@@ -29,6 +29,13 @@ namespace odb
         throw posix_exception (e);
     }
 
+    inline void condition::
+    broadcast ()
+    {
+      if (int e = pthread_cond_broadcast (&cond_))
+        throw posix_exception (e);
+    }
+
     inline void condition::
     wait ()
     {
@@ -9,10 +9,17 @@
 
 #include <pthread.h>
 
+#include <odb/details/config.hxx> // ODB_CXX11_THREAD_LOCAL
+
 namespace odb
 {
   namespace details
   {
+    // If thread_local is supported, then the lookup is just a memory
+    // access. For tls<T> the pthread key is still used to destroy the
+    // object when the thread exits (thread_local objects are constructed
+    // eagerly and cannot be destroyed early).
+    //
     template <typename T>
     class tls
     {
@@ -40,6 +47,10 @@ namespace odb
       static int error_;
       static pthread_once_t once_;
       static pthread_key_t key_;
+
+#ifdef ODB_CXX11_THREAD_LOCAL
+      static thread_local T* value_;
+#endif
     };
 
     template <typename T>
@@ -59,6 +70,9 @@ namespace odb
       tls& operator= (const tls&);
 
     private:
+#ifdef ODB_CXX11_THREAD_LOCAL
+      static thread_local T* value_;
+#else
       static void
       key_init ();
 
@@ -66,6 +80,7 @@ namespace odb
       static int error_;
       static pthread_once_t once_;
       static pthread_key_t key_;
+#endif
     };
 
     template <typename T>
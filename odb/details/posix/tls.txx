@@ -21,10 +21,20 @@ namespace odb
     template <typename T>
     pthread_key_t tls<T>::key_;
 
+#ifdef ODB_CXX11_THREAD_LOCAL
+    template <typename T>
+    thread_local T* tls<T>::value_ = 0;
+#endif
+
     template <typename T>
     T& tls<T>::
     get () const
     {
+#ifdef ODB_CXX11_THREAD_LOCAL
+      if (value_ != 0)
+        return *value_;
+#endif
+
       int e (pthread_once (&once_, key_init));
 
       if (e != 0 || error_ != 0)
@@ -40,6 +50,10 @@ namespace odb
 
       T& r (*p);
       p.release ();
+
+#ifdef ODB_CXX11_THREAD_LOCAL
+      value_ = &r;
+#endif
       return r;
     }
 
@@ -57,6 +71,9 @@ namespace odb
         if ((e = pthread_setspecific (key_, 0)))
           throw posix_exception (e);
 
+#ifdef ODB_CXX11_THREAD_LOCAL
+        value_ = 0;
+#endif
         delete static_cast<T*> (v);
       }
     }
@@ -78,6 +95,24 @@ namespace odb
     // tls<T*>
     //
 
+#ifdef ODB_CXX11_THREAD_LOCAL
+    template <typename T>
+    thread_local T* tls<T*>::value_ = 0;
+
+    template <typename T>
+    T* tls<T*>::
+    get () const
+    {
+      return value_;
+    }
+
+    template <typename T>
+    void tls<T*>::
+    set (T* p)
+    {
+      value_ = p;
+    }
+#else
     template <typename T>
     int tls<T*>::error_ = 0;
 
@@ -118,5 +153,6 @@ namespace odb
     {
       error_ = pthread_key_create (&key_, 0);
     }
+#endif
   }
 }
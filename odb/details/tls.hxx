@@ -54,8 +54,16 @@ namespace odb
 
 #  include <odb/details/posix/tls.hxx>
 
-#  ifdef ODB_THREADS_TLS_KEYWORD
-#    define ODB_TLS_POINTER(type) __thread type*
+// Prefer the native TLS keywords to the pthread key-based tls<T*>
+// since a lookup is then just a memory access. The __thread keyword,
+// if detected, is used in C++98 mode as well.
+//
+#  if defined(ODB_THREADS_TLS_KEYWORD) || defined(ODB_CXX11_THREAD_LOCAL)
+#    ifdef ODB_THREADS_TLS_KEYWORD
+#      define ODB_TLS_POINTER(type) __thread type*
+#    else
+#      define ODB_TLS_POINTER(type) thread_local type*
+#    endif
 
 namespace odb
 {
@@ -27,6 +27,26 @@ namespace odb
       mutex_.unlock ();
     }
 
+    void condition::
+    broadcast ()
+    {
+      mutex_.lock ();
+
+      // Signal all the current waiters. The first thread to wake up
+      // wakes up the next one and so on (see wait() below).
+      //
+      if (waiters_ > signals_)
+      {
+        bool s (signals_ == 0);
+        signals_ = waiters_;
+
+        if (s && SetEvent (event_) == 0)
+          throw win32_exception ();
+      }
+
+      mutex_.unlock ();
+    }
+
     void condition::
     wait ()
     {
@@ -0,0 +1,87 @@
+// file      : odb/dirty-mask.hxx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#ifndef ODB_DIRTY_MASK_HXX
+#define ODB_DIRTY_MASK_HXX
+
+#include <odb/pre.hxx>
+
+#include <vector>
+#include <cstddef> // std::size_t
+
+namespace odb
+{
+  // Set of changed columns for a partial UPDATE. Bit i corresponds to
+  // the i-th element of the UPDATE statement's parameter bind array,
+  // which is the only index space used (see
+  // statement::process_update_changed()). Mapping data members (which
+  // can span several elements, for example, composite values) to bind
+  // elements as well as skipping and clearing is up to the caller;
+  // nothing in the common runtime does this automatically. An empty
+  // mask does not allocate.
+  //
+  class dirty_mask
+  {
+  public:
+    dirty_mask () {}
+
+    // Mark the i-th element as changed.
+    //
+    void
+    set (std::size_t i)
+    {
+      std::size_t b (i / 8);
+
+      if (b >= bits_.size ())
+        bits_.resize (b + 1, 0);
+
+      bits_[b] |= static_cast<unsigned char> (1U << (i % 8));
+    }
+
+    // Mark the i-th element as unchanged.
+    //
+    void
+    reset (std::size_t i)
+    {
+      std::size_t b (i / 8);
+
+      if (b < bits_.size ())
+        bits_[b] &= static_cast<unsigned char> (~(1U << (i % 8)));
+    }
+
+    bool
+    test (std::size_t i) const
+    {
+      std::size_t b (i / 8);
+      return b < bits_.size () && (bits_[b] & (1U << (i % 8))) != 0;
+    }
+
+    // Return true if any element is marked as changed.
+    //
+    bool
+    any () const
+    {
+      for (std::size_t i (0); i != bits_.size (); ++i)
+        if (bits_[i] != 0)
+          return true;
+
+      return false;
+    }
+
+    // Mark all the elements as unchanged.
+    //
+    void
+    clear () {bits_.clear ();}
+
+    void
+    swap (dirty_mask& x) {bits_.swap (x.bits_);}
+
+  private:
+    std::vector<unsigned char> bits_;
+  };
+}
+
+#include <odb/post.hxx>
+
+#endif // ODB_DIRTY_MASK_HXX
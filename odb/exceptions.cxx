@@ -5,6 +5,7 @@
 #include <cstring> // std::strlen
 #include <sstream>
 #include <cassert>
+#include <algorithm> // std::lower_bound
 
 #include <odb/exceptions.hxx>
 
@@ -108,6 +109,42 @@ namespace odb
     return new deadlock (*this);
   }
 
+  const char* group_rolled_back::
+  what () const throw ()
+  {
+    return "shared transaction rolled back due to another unit of work";
+  }
+
+  group_rolled_back* group_rolled_back::
+  clone () const
+  {
+    return new group_rolled_back (*this);
+  }
+
+  const char* read_only_transaction::
+  what () const throw ()
+  {
+    return "modification in read-only transaction";
+  }
+
+  read_only_transaction* read_only_transaction::
+  clone () const
+  {
+    return new read_only_transaction (*this);
+  }
+
+  const char* parallel_part_failed::
+  what () const throw ()
+  {
+    return "part of parallel operation failed with non-ODB exception";
+  }
+
+  parallel_part_failed* parallel_part_failed::
+  clone () const
+  {
+    return new parallel_part_failed (*this);
+  }
+
   const char* connection_lost::
   what () const throw ()
   {
@@ -256,6 +293,18 @@ namespace odb
     return new prepared_type_mismatch (*this);
   }
 
+  const char* query_not_evaluable::
+  what () const throw ()
+  {
+    return "query cannot be evaluated in memory";
+  }
+
+  query_not_evaluable* query_not_evaluable::
+  clone () const
+  {
+    return new query_not_evaluable (*this);
+  }
+
   unknown_schema::
   unknown_schema (const string& name)
       : name_ (name)
@@ -341,20 +390,44 @@ namespace odb
   void multiple_exceptions::
   insert (size_t p, bool maybe, const odb::exception& e, bool fatal)
   {
-    details::shared_ptr<odb::exception> pe;
+    p += delta_;
+    fatal_ = fatal_ || fatal;
+
+    // Positions normally come in the increasing order so in most cases
+    // we just append. Otherwise, find the place to insert while keeping
+    // the first failure recorded for a position.
+    //
+    set_type::iterator i (set_.end ());
+
+    if (!set_.empty () && set_.back ().position () >= p)
+    {
+      i = lower_bound (
+        set_.begin (), set_.end (), value_type (p), comparator_type ());
+
+      if (i->position () == p)
+        return;
+    }
+
+    const odb::exception* pe;
 
     if (common_exception_ti_ != typeid (e))
-      pe.reset (e.clone ());
+    {
+      exceptions_.push_back (details::shared_ptr<odb::exception> (e.clone ()));
+      pe = exceptions_.back ().get ();
+    }
     else
     {
       if (common_exception_ == 0)
-        common_exception_.reset (e.clone ());
+      {
+        exceptions_.push_back (
+          details::shared_ptr<odb::exception> (e.clone ()));
+        common_exception_ = exceptions_.back ().get ();
+      }
 
       pe = common_exception_;
     }
 
-    set_.insert (value_type (delta_ + p, maybe, pe));
-    fatal_ = fatal_ || fatal;
+    set_.insert (i, value_type (p, maybe, pe));
   }
 
   const multiple_exceptions::value_type* multiple_exceptions::
@@ -362,8 +435,11 @@ namespace odb
   {
     p += delta_; // Called while populating multiple_exceptions.
 
-    iterator i (set_.find (value_type (p)));
-    return i == set_.end () ? 0 : &*i;
+    iterator i (
+      lower_bound (set_.begin (), set_.end (), value_type (p),
+                   comparator_type ()));
+
+    return i != set_.end () && i->position () == p ? &*i : 0;
   }
 
   void multiple_exceptions::
@@ -371,7 +447,6 @@ namespace odb
   {
     current_ = 0;
     delta_ = 0;
-    common_exception_.reset ();
 
     ostringstream os;
     os << "multiple exceptions, "
@@ -7,8 +7,8 @@
 
 #include <odb/pre.hxx>
 
-#include <set>
 #include <string>
+#include <vector>
 #include <cstddef>  // std::size_t
 #include <typeinfo>
 
@@ -121,6 +121,41 @@ namespace odb
     clone () const;
   };
 
+  // Thrown (or reported) when a transaction shared by several units of
+  // work is rolled back because of another unit's failure (see
+  // group_commit).
+  //
+  struct LIBODB_EXPORT group_rolled_back: recoverable
+  {
+    virtual const char*
+    what () const throw ();
+
+    virtual group_rolled_back*
+    clone () const;
+  };
+
+  struct LIBODB_EXPORT read_only_transaction: odb::exception
+  {
+    virtual const char*
+    what () const throw ();
+
+    virtual read_only_transaction*
+    clone () const;
+  };
+
+  // Reported when a part of a parallel operation (see
+  // database::persist_parallel()) fails with an exception that is not
+  // an ODB exception, for example, std::bad_alloc.
+  //
+  struct LIBODB_EXPORT parallel_part_failed: odb::exception
+  {
+    virtual const char*
+    what () const throw ();
+
+    virtual parallel_part_failed*
+    clone () const;
+  };
+
   struct LIBODB_EXPORT object_not_persistent: odb::exception
   {
     virtual const char*
@@ -225,6 +260,17 @@ namespace odb
     std::string what_;
   };
 
+  // In-memory query evaluation exceptions.
+  //
+  struct LIBODB_EXPORT query_not_evaluable: odb::exception
+  {
+    virtual const char*
+    what () const throw ();
+
+    virtual query_not_evaluable*
+    clone () const;
+  };
+
   // Schema catalog exceptions.
   //
   struct LIBODB_EXPORT unknown_schema: odb::exception
@@ -309,17 +355,15 @@ namespace odb
       // Implementation details.
       //
     public:
-      value_type (std::size_t p,
-                  bool maybe,
-                  details::shared_ptr<odb::exception> e)
+      value_type (std::size_t p, bool maybe, const odb::exception* e)
           : m_ (maybe), p_ (p), e_ (e) {}
 
-      value_type (std::size_t p): p_ (p) {} // "Key" for set lookup.
+      value_type (std::size_t p): m_ (false), p_ (p), e_ (0) {} // "Key".
 
     private:
       bool m_;
       std::size_t p_;
-      details::shared_ptr<odb::exception> e_;
+      const odb::exception* e_; // Owned by multiple_exceptions.
     };
 
     struct LIBODB_EXPORT comparator_type
@@ -331,7 +375,11 @@ namespace odb
       }
     };
 
-    typedef std::set<value_type, comparator_type> set_type;
+    // Failed positions in the increasing order. Each element refers to
+    // an exception instance owned by multiple_exceptions with all the
+    // common exception failures sharing the same instance.
+    //
+    typedef std::vector<value_type> set_type;
 
     // Iteration.
     //
@@ -420,6 +468,7 @@ namespace odb
     //
     multiple_exceptions (const std::type_info& common_exception_ti)
         : common_exception_ti_ (common_exception_ti),
+          common_exception_ (0),
           fatal_ (false),
           delta_ (0),
           current_ (0) {}
@@ -472,8 +521,11 @@ namespace odb
     lookup (std::size_t p) const;
 
   private:
+    typedef std::vector<details::shared_ptr<odb::exception> > exceptions_type;
+
     const std::type_info& common_exception_ti_;
-    details::shared_ptr<odb::exception> common_exception_;
+    const odb::exception* common_exception_; // In exceptions_ if not NULL.
+    exceptions_type exceptions_;
 
     set_type set_;
     bool fatal_;
@@ -499,6 +551,9 @@ namespace odb
     using odb::deadlock;
     using odb::connection_lost;
     using odb::timeout;
+    using odb::group_rolled_back;
+    using odb::read_only_transaction;
+    using odb::parallel_part_failed;
     using odb::object_not_persistent;
     using odb::object_already_persistent;
     using odb::object_changed;
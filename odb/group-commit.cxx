@@ -0,0 +1,279 @@
+// file      : odb/group-commit.cxx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#include <odb/details/config.hxx> // ODB_CXX11
+
+// VC++ 10 does not have <chrono>.
+//
+#if defined(ODB_CXX11) && (!defined(_MSC_VER) || _MSC_VER >= 1700)
+#  include <chrono>
+#  define ODB_GROUP_COMMIT_CLOCK
+#endif
+
+#include <odb/database.hxx>
+#include <odb/exceptions.hxx>
+#include <odb/group-commit.hxx>
+
+#include <odb/details/lock.hxx>
+
+using namespace std;
+
+namespace odb
+{
+  using details::lock;
+
+  // Current time in microseconds or 0 if unavailable.
+  //
+  static unsigned long long
+  group_commit_now ()
+  {
+#ifdef ODB_GROUP_COMMIT_CLOCK
+    using namespace std::chrono;
+
+    return static_cast<unsigned long long> (
+      duration_cast<microseconds> (
+        steady_clock::now ().time_since_epoch ()).count ()) | 1;
+#else
+    return 0;
+#endif
+  }
+
+  group_commit::
+  group_commit (database& db, size_t max_units, unsigned long max_delay)
+      : db_ (db),
+        max_units_ (max_units != 0 ? max_units : 1),
+        max_delay_ (max_delay),
+        cond_ (mutex_),
+        open_ (0),
+        committing_ (false)
+  {
+  }
+
+  group_commit::
+  ~group_commit ()
+  {
+    group* g;
+    commit_future f;
+    {
+      lock l (mutex_);
+      g = open_;
+      f.swap (open_future_);
+      open_ = 0;
+    }
+
+    if (g != 0)
+    {
+      try {g->t.rollback ();} catch (...) {}
+      g->error.reset (new group_rolled_back);
+
+      lock l (mutex_);
+      g->done = true;
+      cond_.broadcast ();
+    }
+  }
+
+  void group_commit::
+  flush ()
+  {
+    commit_future f;
+    {
+      lock l (mutex_);
+
+      if (open_ == 0)
+        return;
+
+      f = open_future_;
+    }
+
+    f.wait ();
+  }
+
+  group_commit::group* group_commit::
+  join_ (commit_future& r)
+  {
+    if (transaction::has_current ())
+      throw already_in_transaction ();
+
+    lock l (mutex_);
+
+    // Units are executed one at a time so wait until the open group (if
+    // any) is not busy.
+    //
+    while (open_ != 0 && open_->busy)
+      cond_.wait ();
+
+    group* g (open_);
+    bool start (g == 0);
+
+    if (start)
+    {
+      g = new group (*this);
+      commit_future f (g);
+
+      open_ = g;
+      open_future_.swap (f);
+    }
+
+    r = open_future_;
+
+    g->busy = true;
+
+    // Close the group if it is full. The caller will commit it once the
+    // unit has been executed.
+    //
+    if (++g->units == max_units_)
+    {
+      open_ = 0;
+      open_future_ = commit_future ();
+    }
+
+    l.unlock ();
+
+    // Begin the new group's transaction without holding the lock since
+    // this may have to wait for a connection. Being busy, the group
+    // cannot be joined or committed in the meantime.
+    //
+    if (start)
+    {
+      try
+      {
+        g->t.reset (db_.begin (), false);
+        g->start = group_commit_now ();
+      }
+      catch (...)
+      {
+        lock l (mutex_);
+
+        if (open_ == g)
+        {
+          open_ = 0;
+          open_future_ = commit_future ();
+        }
+
+        g->busy = false;
+        g->error.reset (new group_rolled_back);
+        g->done = true;
+        cond_.broadcast ();
+        throw;
+      }
+    }
+
+    transaction::current (g->t);
+    return g;
+  }
+
+  void group_commit::
+  leave_ (group& g, bool failed)
+  {
+    transaction::reset_current ();
+
+    if (!failed)
+    {
+      // Commit the group ourselves if it is full or overdue.
+      //
+      bool commit;
+      {
+        lock l (mutex_);
+        g.busy = false;
+        commit = (g.units == max_units_);
+        cond_.broadcast ();
+      }
+
+      if (!commit && max_delay_ != 0 && g.start != 0)
+        commit = group_commit_now () - g.start >=
+          static_cast<unsigned long long> (max_delay_) * 1000;
+
+      if (commit)
+        wait_ (g);
+
+      return;
+    }
+
+    // The unit may have left the shared transaction in an inconsistent
+    // state so roll the whole group back.
+    //
+    {
+      lock l (mutex_);
+      g.busy = false;
+      g.doomed = true;
+
+      if (open_ == &g)
+      {
+        open_ = 0;
+        open_future_ = commit_future ();
+      }
+    }
+
+    try {g.t.rollback ();} catch (...) {}
+    g.error.reset (new group_rolled_back);
+
+    lock l (mutex_);
+    g.done = true;
+    cond_.broadcast ();
+  }
+
+  void group_commit::
+  wait_ (group& g)
+  {
+    {
+      lock l (mutex_);
+
+      while (!g.done && (committing_ || g.busy || g.doomed))
+        cond_.wait ();
+
+      if (g.done)
+        return;
+
+      // Become the leader: close the group and commit it. Only one
+      // group is committed at a time with the new units gathered into
+      // the next group in the meantime.
+      //
+      if (open_ == &g)
+      {
+        open_ = 0;
+        open_future_ = commit_future ();
+      }
+
+      committing_ = true;
+    }
+
+    finish_ (g);
+
+    lock l (mutex_);
+    g.done = true;
+    committing_ = false;
+    cond_.broadcast ();
+  }
+
+  void group_commit::
+  finish_ (group& g)
+  {
+    try
+    {
+      g.t.commit ();
+      g.committed = true;
+    }
+    catch (const odb::exception& e)
+    {
+      g.error.reset (e.clone ());
+    }
+    catch (...)
+    {
+      g.error.reset (new group_rolled_back);
+    }
+  }
+
+  bool group_commit::group::
+  ready ()
+  {
+    lock l (gc.mutex_);
+    return done;
+  }
+
+  void group_commit::group::
+  wait ()
+  {
+    gc.wait_ (*this);
+  }
+}
@@ -0,0 +1,146 @@
+// file      : odb/group-commit.hxx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#ifndef ODB_GROUP_COMMIT_HXX
+#define ODB_GROUP_COMMIT_HXX
+
+#include <odb/pre.hxx>
+
+#include <cstddef> // std::size_t
+
+#include <odb/forward.hxx>
+#include <odb/transaction.hxx>
+#include <odb/commit-future.hxx>
+
+#include <odb/details/mutex.hxx>
+#include <odb/details/condition.hxx>
+#include <odb/details/export.hxx>
+
+namespace odb
+{
+  // Group commit coordinator. Small units of work from concurrent
+  // threads are executed in a shared transaction which is then
+  // committed once for all of them, amortizing the commit latency (for
+  // example, the log flush on the server).
+  //
+  // The execute() function runs the unit of work in the calling thread
+  // with the shared transaction being current (units are executed one
+  // at a time) and returns a future for the outcome of the shared
+  // commit. The group is committed by the first of its members to wait
+  // for the outcome provided no other group is being committed at the
+  // time. Units that arrive while a commit is in progress are gathered
+  // into the next group. Once a group has max_units units, the caller
+  // that has added the last unit commits it before returning. The same
+  // happens for the unit that completes max_delay milliseconds or more
+  // after the group's transaction has begun (0 means no limit; the time
+  // is only measured with C++11).
+  //
+  // Note that a group is only committed by one of its members. If none
+  // of them waits for the outcome and no further units arrive, then the
+  // group's transaction (and the connection) stays open until flush()
+  // is called or the coordinator is destroyed.
+  //
+  // If a unit of work throws, then the exception is propagated from
+  // execute() and the whole group is rolled back with the other members'
+  // futures reporting group_rolled_back (which is recoverable). The
+  // transaction callbacks registered by the units are called on the
+  // shared commit or rollback, that is, in the thread that commits or
+  // rolls back the group which is not necessarily the thread that has
+  // registered them.
+  //
+  // No transaction should be in effect in the calling thread and the
+  // coordinator should outlive the returned futures. The destructor
+  // rolls back the group that has not yet been committed, so call
+  // flush() first if that is not desired.
+  //
+  class LIBODB_EXPORT group_commit
+  {
+  public:
+    explicit
+    group_commit (database&,
+                  std::size_t max_units = 64,
+                  unsigned long max_delay = 0);
+
+    ~group_commit ();
+
+    template <typename F>
+    commit_future
+    execute (F f);
+
+    // Commit the current group, if any, and wait for the outcome.
+    //
+    void
+    flush ();
+
+  private:
+    group_commit (const group_commit&);
+    group_commit& operator= (const group_commit&);
+
+  private:
+    struct group;
+    friend struct group;
+
+    struct group: commit_future::state
+    {
+      group (group_commit& c)
+          : gc (c),
+            units (0),
+            start (0),
+            busy (false),
+            doomed (false),
+            done (false)
+      {
+      }
+
+      virtual bool
+      ready ();
+
+      virtual void
+      wait ();
+
+      group_commit& gc;
+      transaction t;
+
+      std::size_t units;
+      unsigned long long start; // Transaction begin time or 0.
+      bool busy;   // A unit is being executed or the group is starting.
+      bool doomed; // A unit has failed and the group is being rolled back.
+      bool done;
+    };
+
+    group*
+    join_ (commit_future&);
+
+    void
+    leave_ (group&, bool failed);
+
+    void
+    wait_ (group&);
+
+    void
+    finish_ (group&);
+
+  private:
+    database& db_;
+    std::size_t max_units_;
+    unsigned long max_delay_; // Milliseconds.
+
+    details::mutex mutex_;
+    details::condition cond_;
+
+    // The group accepting new units, if any. The future holds a
+    // reference to it.
+    //
+    group* open_;
+    commit_future open_future_;
+
+    bool committing_;
+  };
+}
+
+#include <odb/group-commit.txx>
+
+#include <odb/post.hxx>
+
+#endif // ODB_GROUP_COMMIT_HXX
@@ -0,0 +1,27 @@
+// file      : odb/group-commit.txx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+namespace odb
+{
+  template <typename F>
+  commit_future group_commit::
+  execute (F f)
+  {
+    commit_future r;
+    group& g (*join_ (r));
+
+    try
+    {
+      f ();
+    }
+    catch (...)
+    {
+      leave_ (g, true);
+      throw;
+    }
+
+    leave_ (g, false);
+    return r;
+  }
+}
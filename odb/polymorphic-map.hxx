@@ -237,6 +237,33 @@ namespace odb
     return r;
   }
 
+  // Bulk operations.
+  //
+  // The number of objects that are passed to polymorphic_bulk() at a
+  // time.
+  //
+  const std::size_t polymorphic_batch = 256;
+
+  // Perform the operation on n objects in order, dispatching each by its
+  // dynamic type. Failures with the common exception are recorded in mex
+  // at the corresponding positions. Other exceptions are thrown.
+  //
+  // Note that this only batches the bookkeeping (session cache, callbacks,
+  // and exception collection). Each object is still written with its own
+  // statements since the ODB compiler does not generate batch-capable
+  // persist(), update(), and erase() for polymorphic types. Erasing
+  // polymorphic objects by id (database::erase_id_()) is also done one
+  // object at a time since the dynamic type is not known from the id.
+  //
+  template <typename R, database_id DB>
+  void
+  polymorphic_bulk (typename polymorphic_concrete_info<R>::call_type,
+                    database&,
+                    const R* const*,
+                    std::size_t n,
+                    const std::type_info& common_exception_ti,
+                    multiple_exceptions& mex);
+
   template <typename T, database_id DB, typename ST>
   void
   section_load_impl (odb::connection& conn,
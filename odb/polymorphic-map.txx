@@ -35,6 +35,44 @@ namespace odb
       throw no_type_info ();
   }
 
+  //
+  // polymorphic_bulk
+  //
+
+  template <typename R, database_id DB>
+  void
+  polymorphic_bulk (typename polymorphic_concrete_info<R>::call_type c,
+                    database& db,
+                    const R* const* objs,
+                    std::size_t n,
+                    const std::type_info& common_exception_ti,
+                    multiple_exceptions& mex)
+  {
+    typedef object_traits_impl<R, DB> root_traits;
+    typedef polymorphic_concrete_info<R> info_type;
+
+    mex.attempted (n);
+
+    for (std::size_t i (0); i != n; ++i)
+    {
+      mex.current (i); // Set position in case the below code throws.
+
+      const info_type& pi (root_traits::map->find (typeid (*objs[i])));
+
+      try
+      {
+        pi.dispatch (c, db, objs[i], 0);
+      }
+      catch (const odb::exception& e)
+      {
+        if (typeid (e) != common_exception_ti)
+          throw;
+
+        mex.insert (e);
+      }
+    }
+  }
+
   //
   // polymorphic_entry_impl
   //
@@ -2,6 +2,8 @@
 // copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
 // license   : GNU GPL v2; see accompanying LICENSE file
 
+#include <set>
+
 #include <odb/query-dynamic.hxx>
 
 using namespace std;
@@ -15,6 +17,53 @@ namespace odb
   {
   }
 
+  // query_range_param
+  //
+  query_range_param::
+  ~query_range_param ()
+  {
+  }
+
+  // Stand-in for a range parameter in a stripped query (see
+  // query_base::structure()) that only preserves the window size.
+  //
+  struct structure_range_param: query_range_param
+  {
+    structure_range_param (size_t n): query_range_param (0), n_ (n) {}
+
+    virtual size_t
+    size () const
+    {
+      return n_;
+    }
+
+    virtual const void*
+    element (size_t) const
+    {
+      return 0;
+    }
+
+    virtual query_range_param*
+    clone () const
+    {
+      return new (details::shared) structure_range_param (n_);
+    }
+
+  private:
+    size_t n_;
+  };
+
+  // Number of elements in the range window.
+  //
+  static inline size_t
+  range_size (const query_base::clause_part& x)
+  {
+    const query_range_param* qp (
+      reinterpret_cast<const query_range_param*> (x.data));
+
+    return qp != 0 ? qp->window_end () - qp->window_begin () : 0;
+  }
+
   // query_base
   //
   void query_base::
@@ -23,7 +72,8 @@ namespace odb
     for (clause_type::iterator i (clause_.begin ()); i != clause_.end (); ++i)
     {
       if (i->kind == clause_part::kind_param_val ||
-          i->kind == clause_part::kind_param_ref)
+          i->kind == clause_part::kind_param_ref ||
+          i->kind == clause_part::kind_param_range)
       {
         query_param* qp (reinterpret_cast<query_param*> (i->data));
 
@@ -48,11 +98,21 @@ namespace odb
   void query_base::
   append (const query_base& x)
   {
-    size_t i (clause_.size ()), delta (i);
-    size_t n (i + x.clause_.size ());
+    append (x, 0, x.clause_.size ());
+  }
+
+  void query_base::
+  append (const query_base& x, size_t b, size_t e)
+  {
+    // Note that delta can wrap around if we are appending a sub-expression
+    // to a shorter query. This is ok since the argument positions are
+    // always at or after the beginning of the sub-expression.
+    //
+    size_t i (clause_.size ()), delta (i - b);
+    size_t n (i + (e - b));
     clause_.resize (n);
 
-    for (size_t j (0); i < n; ++i, ++j)
+    for (size_t j (b); i < n; ++i, ++j)
     {
       const clause_part& s (x.clause_[j]);
       clause_part& d (clause_[i]);
@@ -66,8 +126,12 @@ namespace odb
       {
       case clause_part::kind_param_val:
       case clause_part::kind_param_ref:
+      case clause_part::kind_param_range:
         {
-          reinterpret_cast<query_param*> (d.data)->_inc_ref ();
+          // Parameters can be stripped (see structure()).
+          //
+          if (d.data != 0)
+            reinterpret_cast<query_param*> (d.data)->_inc_ref ();
           break;
         }
       case clause_part::kind_native:
@@ -121,6 +185,580 @@ namespace odb
       new (details::shared) query_param (ref));
   }
 
+  // FNV-1a over the machine words.
+  //
+  static inline size_t
+  hash_combine (size_t h, size_t v)
+  {
+    for (size_t i (0); i != sizeof (size_t); ++i, v >>= 8)
+    {
+      h ^= v & 0xFF;
+      h *= static_cast<size_t> (16777619UL);
+    }
+
+    return h;
+  }
+
+  size_t query_base::
+  structure_hash () const
+  {
+    return clause_.empty ()
+      ? structure_hash (0, 0, strings_)
+      : structure_hash (&clause_[0], clause_.size (), strings_);
+  }
+
+  size_t query_base::
+  structure_hash (const clause_part* c, size_t n, const strings_type& ss)
+  {
+    size_t h (static_cast<size_t> (2166136261UL));
+
+    for (const clause_part* i (c), *e (c + n); i != e; ++i)
+    {
+      h = hash_combine (h, static_cast<size_t> (i->kind));
+
+      switch (i->kind)
+      {
+      case clause_part::kind_column:
+      case clause_part::kind_param_val:
+      case clause_part::kind_param_ref:
+        {
+          // The parameter value is not part of the structure but the
+          // column it is converted for is.
+          //
+          h = hash_combine (h, reinterpret_cast<size_t> (i->native_info));
+          break;
+        }
+      case clause_part::kind_param_range:
+        {
+          h = hash_combine (h, reinterpret_cast<size_t> (i->native_info));
+          h = hash_combine (h, range_size (*i));
+          break;
+        }
+      case clause_part::kind_native:
+        {
+          const string& s (ss[i->data]);
+
+          for (string::const_iterator j (s.begin ()); j != s.end (); ++j)
+          {
+            h ^= static_cast<unsigned char> (*j);
+            h *= static_cast<size_t> (16777619UL);
+          }
+
+          break;
+        }
+      case clause_part::kind_true:
+      case clause_part::kind_false:
+        break;
+      case clause_part::op_add:
+
+      case clause_part::op_and:
+      case clause_part::op_or:
+      case clause_part::op_not:
+
+      case clause_part::op_null:
+      case clause_part::op_not_null:
+
+      case clause_part::op_in:
+      case clause_part::op_like:
+      case clause_part::op_like_escape:
+
+      case clause_part::op_eq:
+      case clause_part::op_ne:
+      case clause_part::op_lt:
+      case clause_part::op_gt:
+      case clause_part::op_le:
+      case clause_part::op_ge:
+        {
+          // For operators data is either the position of the left hand
+          // side or the argument count.
+          //
+          h = hash_combine (h, i->data);
+          break;
+        }
+      }
+    }
+
+    return h;
+  }
+
+  bool query_base::
+  structure_equal (const query_base& x) const
+  {
+    return clause_.empty ()
+      ? x.clause_.empty ()
+      : x.structure_equal (&clause_[0], clause_.size (), strings_);
+  }
+
+  bool query_base::
+  structure_equal (const clause_part* c,
+                   size_t n,
+                   const strings_type& ss) const
+  {
+    if (clause_.size () != n)
+      return false;
+
+    for (size_t i (0); i != n; ++i)
+    {
+      const clause_part& a (c[i]);
+      const clause_part& b (clause_[i]);
+
+      if (a.kind != b.kind)
+        return false;
+
+      switch (a.kind)
+      {
+      case clause_part::kind_column:
+      case clause_part::kind_param_val:
+      case clause_part::kind_param_ref:
+        {
+          if (a.native_info != b.native_info)
+            return false;
+          break;
+        }
+      case clause_part::kind_param_range:
+        {
+          if (a.native_info != b.native_info ||
+              range_size (a) != range_size (b))
+            return false;
+          break;
+        }
+      case clause_part::kind_native:
+        {
+          if (ss[a.data] != strings_[b.data])
+            return false;
+          break;
+        }
+      case clause_part::kind_true:
+      case clause_part::kind_false:
+        break;
+      case clause_part::op_add:
+
+      case clause_part::op_and:
+      case clause_part::op_or:
+      case clause_part::op_not:
+
+      case clause_part::op_null:
+      case clause_part::op_not_null:
+
+      case clause_part::op_in:
+      case clause_part::op_like:
+      case clause_part::op_like_escape:
+
+      case clause_part::op_eq:
+      case clause_part::op_ne:
+      case clause_part::op_lt:
+      case clause_part::op_gt:
+      case clause_part::op_le:
+      case clause_part::op_ge:
+        {
+          if (a.data != b.data)
+            return false;
+          break;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  query_base query_base::
+  structure () const
+  {
+    query_base r;
+    r.clause_ = clause_;
+    r.strings_ = strings_;
+
+    for (clause_type::iterator i (r.clause_.begin ());
+         i != r.clause_.end ();
+         ++i)
+    {
+      if (i->kind == clause_part::kind_param_val ||
+          i->kind == clause_part::kind_param_ref)
+        i->data = 0;
+      else if (i->kind == clause_part::kind_param_range)
+      {
+        // Keep the window size which is part of the structure.
+        //
+        size_t n (range_size (*i));
+        i->data = 0; // In case new below throws.
+        i->data = reinterpret_cast<size_t> (
+          new (details::shared) structure_range_param (n));
+      }
+    }
+
+    return r;
+  }
+
+  // Normalization.
+  //
+  typedef query_base::clause_type clause_type;
+  typedef query_base::clause_part clause_part;
+
+  // Return the position of the first part of the sub-expression that
+  // ends at position p.
+  //
+  static size_t
+  expression_begin (const clause_type& c, size_t p)
+  {
+    for (;;)
+    {
+      const clause_part& x (c[p]);
+
+      switch (x.kind)
+      {
+      case clause_part::kind_column:
+      case clause_part::kind_param_val:
+      case clause_part::kind_param_ref:
+      case clause_part::kind_param_range:
+      case clause_part::kind_native:
+      case clause_part::kind_true:
+      case clause_part::kind_false:
+        return p;
+
+      case clause_part::op_add:
+
+      case clause_part::op_and:
+      case clause_part::op_or:
+
+      case clause_part::op_eq:
+      case clause_part::op_ne:
+      case clause_part::op_lt:
+      case clause_part::op_gt:
+      case clause_part::op_le:
+      case clause_part::op_ge:
+        {
+          p = x.data;
+          break;
+        }
+      case clause_part::op_not:
+      case clause_part::op_null:
+      case clause_part::op_not_null:
+        {
+          p = p - 1;
+          break;
+        }
+      case clause_part::op_in:
+        {
+          p = p - x.data - 1;
+          break;
+        }
+      case clause_part::op_like:
+        {
+          p = p - 2;
+          break;
+        }
+      case clause_part::op_like_escape:
+        {
+          p = p - 3;
+          break;
+        }
+      }
+    }
+  }
+
+  // Collect the operands of a chain of op operators in the left to right
+  // order. Use an explicit stack since the chains can be long.
+  //
+  static void
+  chain_operands (const clause_type& c,
+                  size_t p,
+                  clause_part::kind_type op,
+                  vector<size_t>& r)
+  {
+    vector<size_t> s (1, p);
+
+    while (!s.empty ())
+    {
+      p = s.back ();
+      s.pop_back ();
+
+      if (c[p].kind == op)
+      {
+        s.push_back (p - 1);     // Right hand side.
+        s.push_back (c[p].data); // Left hand side.
+      }
+      else
+        r.push_back (p);
+    }
+  }
+
+  static inline bool
+  const_value (const query_base& q, clause_part::kind_type k)
+  {
+    return q.clause ().size () == 1 && q.clause ().front ().kind == k;
+  }
+
+  // Append to r (which should be empty) the normalized sub-expression
+  // that ends at position p in s.
+  //
+  static void
+  normalize_expression (const query_base& s, size_t p, query_base& r)
+  {
+    const clause_type& c (s.clause ());
+    const clause_part& x (c[p]);
+
+    switch (x.kind)
+    {
+    case clause_part::op_and:
+    case clause_part::op_or:
+      {
+        // For AND false is absorbing and true is neutral. For OR it is
+        // the other way around.
+        //
+        clause_part::kind_type absorbing (
+          x.kind == clause_part::op_and
+          ? clause_part::kind_false
+          : clause_part::kind_true);
+
+        clause_part::kind_type neutral (
+          x.kind == clause_part::op_and
+          ? clause_part::kind_true
+          : clause_part::kind_false);
+
+        vector<size_t> ops;
+        chain_operands (c, p, x.kind, ops);
+
+        for (vector<size_t>::iterator i (ops.begin ()); i != ops.end (); ++i)
+        {
+          query_base t;
+          normalize_expression (s, *i, t);
+
+          if (const_value (t, absorbing))
+          {
+            r.clear ();
+            r.append (absorbing, 0);
+            return;
+          }
+
+          if (t.empty () || const_value (t, neutral))
+            continue;
+
+          // The normalized operand can itself be a chain of the same
+          // operator (e.g., after removing a double negation), in which
+          // case we splice its operands into our chain.
+          //
+          vector<size_t> tops;
+          chain_operands (t.clause (), t.clause ().size () - 1, x.kind, tops);
+
+          for (vector<size_t>::iterator j (tops.begin ());
+               j != tops.end ();
+               ++j)
+          {
+            size_t n (r.clause ().size ());
+            r.append (t, expression_begin (t.clause (), *j), *j + 1);
+
+            if (n != 0)
+              r.append (x.kind, n - 1);
+          }
+        }
+
+        if (r.empty ())
+          r.append (neutral, 0);
+
+        break;
+      }
+    case clause_part::op_not:
+      {
+        query_base t;
+        normalize_expression (s, p - 1, t);
+
+        if (const_value (t, clause_part::kind_true))
+          r.append (clause_part::kind_false, 0);
+        else if (const_value (t, clause_part::kind_false))
+          r.append (clause_part::kind_true, 0);
+        else if (t.clause ().back ().kind == clause_part::op_not)
+          r.append (t, 0, t.clause ().size () - 1);
+        else
+        {
+          r.append (t);
+          r.append (clause_part::op_not, 0);
+        }
+
+        break;
+      }
+    case clause_part::op_add:
+      {
+        // The concatenated fragments can contain logical expressions
+        // (e.g., a condition followed by ORDER BY) but constants at
+        // this level are not folded.
+        //
+        query_base l, t;
+        normalize_expression (s, x.data, l);
+        normalize_expression (s, p - 1, t);
+
+        r.append (l);
+        r.append (t);
+        r.append (clause_part::op_add, l.clause ().size () - 1);
+        break;
+      }
+    case clause_part::op_in:
+      {
+        size_t b (p - x.data - 1);
+
+        // x IN () is always false.
+        //
+        if (x.data == 0)
+        {
+          r.append (clause_part::kind_false, 0);
+          break;
+        }
+
+        // The same goes for a range that is currently empty. Note that
+        // a stripped range (see structure()) is not folded.
+        //
+        if (x.data == 1 && c[b + 1].kind == clause_part::kind_param_range)
+        {
+          const query_range_param* qp (
+            reinterpret_cast<const query_range_param*> (c[b + 1].data));
+
+          if (qp != 0 && qp->size () == 0)
+          {
+            r.append (clause_part::kind_false, 0);
+            break;
+          }
+        }
+
+        r.append (s, b, b + 1); // Column.
+
+        // Parameters that point to the same value are duplicates. Note
+        // that for by-value parameters this is only the case if they
+        // share the same query_param instance.
+        //
+        set<const void*> seen;
+        size_t n (0);
+
+        for (size_t i (b + 1); i != p; ++i)
+        {
+          const query_param* qp (
+            reinterpret_cast<const query_param*> (c[i].data));
+
+          if (qp == 0 || seen.insert (qp->value).second)
+          {
+            r.append (s, i, i + 1);
+            n++;
+          }
+        }
+
+        r.append (clause_part::op_in, n);
+        break;
+      }
+    case clause_part::kind_column:
+    case clause_part::kind_param_val:
+    case clause_part::kind_param_ref:
+    case clause_part::kind_param_range:
+    case clause_part::kind_native:
+    case clause_part::kind_true:
+    case clause_part::kind_false:
+
+    case clause_part::op_null:
+    case clause_part::op_not_null:
+    case clause_part::op_like:
+    case clause_part::op_like_escape:
+
+    case clause_part::op_eq:
+    case clause_part::op_ne:
+    case clause_part::op_lt:
+    case clause_part::op_gt:
+    case clause_part::op_le:
+    case clause_part::op_ge:
+      {
+        r.append (s, expression_begin (c, p), p + 1);
+        break;
+      }
+    }
+  }
+
+  size_t query_base::
+  range_chunks (size_t n) const
+  {
+    // Find the range parameter making sure there is only one.
+    //
+    size_t r (clause_.size ());
+
+    for (size_t i (0); i != clause_.size (); ++i)
+    {
+      if (clause_[i].kind == clause_part::kind_param_range)
+      {
+        if (r != clause_.size ())
+          return 1;
+
+        r = i;
+      }
+    }
+
+    if (r == clause_.size () || n == 0)
+      return 1;
+
+    // Make sure the in() expression (which immediately follows the
+    // range) is a top-level conjunct.
+    //
+    for (size_t p (clause_.size () - 1); p != r + 1;)
+    {
+      const clause_part& x (clause_[p]);
+
+      if (x.kind != clause_part::op_and)
+        return 1;
+
+      p = r + 1 <= x.data ? x.data : p - 1;
+    }
+
+    const query_range_param* qp (
+      reinterpret_cast<const query_range_param*> (clause_[r].data));
+
+    size_t s (qp != 0 ? qp->size () : 0);
+    return s > n ? (s + n - 1) / n : 1;
+  }
+
+  void query_base::
+  range_chunk (size_t i, size_t n)
+  {
+    for (clause_type::iterator j (clause_.begin ()); j != clause_.end (); ++j)
+    {
+      if (j->kind == clause_part::kind_param_range && j->data != 0)
+      {
+        query_range_param* qp (reinterpret_cast<query_range_param*> (j->data));
+
+        // Copy the parameter if it is shared with another query so that
+        // changing the window does not affect it.
+        //
+        if (qp->_ref_count () > 1)
+        {
+          query_range_param* c (qp->clone ());
+          j->data = reinterpret_cast<size_t> (c);
+
+          if (qp->_dec_ref ())
+            delete qp;
+
+          qp = c;
+        }
+
+        if (n != 0)
+        {
+          qp->offset = i * n;
+          qp->count = n;
+        }
+        else
+        {
+          qp->offset = 0;
+          qp->count = ~size_t (0);
+        }
+      }
+    }
+  }
+
+  void query_base::
+  normalize ()
+  {
+    if (clause_.empty ())
+      return;
+
+    query_base r;
+    normalize_expression (*this, clause_.size () - 1, r);
+
+    clause_.swap (r.clause_);
+    strings_.swap (r.strings_);
+  }
+
   query_base& query_base::
   operator+= (const std::string& native)
   {
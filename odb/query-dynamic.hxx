@@ -81,6 +81,106 @@ namespace odb
     const void* value;
   };
 
+  // Range of values bound by reference as a single parameter (see
+  // query_column::in_range()). The window restricts the range to a
+  // chunk of elements if the range is too large to be bound in a single
+  // statement (see query_base::range_chunks()). The number of elements
+  // in the window is part of the query structure since it determines
+  // the number of placeholders in the statement.
+  //
+  struct LIBODB_EXPORT query_range_param: query_param
+  {
+    virtual ~query_range_param ();
+    query_range_param (const void* container)
+        : query_param (container), offset (0), count (~std::size_t (0)) {}
+
+    // Total number of elements in the range.
+    //
+    virtual std::size_t
+    size () const = 0;
+
+    // Return a pointer to the i-th element (which is of the column type).
+    // Sequential access is constant time.
+    //
+    virtual const void*
+    element (std::size_t i) const = 0;
+
+    // Return a copy referring to the same range and with the same window.
+    //
+    virtual query_range_param*
+    clone () const = 0;
+
+    // Elements in the current window are [window_begin (), window_end ()).
+    //
+    std::size_t
+    window_begin () const
+    {
+      std::size_t n (size ());
+      return offset < n ? offset : n;
+    }
+
+    std::size_t
+    window_end () const
+    {
+      std::size_t b (window_begin ()), n (size ());
+      return count < n - b ? b + count : n;
+    }
+
+    std::size_t offset;
+    std::size_t count;
+  };
+
+  template <typename T, typename C>
+  struct container_query_param: query_range_param
+  {
+    container_query_param (const C& c)
+        : query_range_param (&c), c_ (c), i_ (c.begin ()), n_ (0) {}
+
+    virtual std::size_t
+    size () const
+    {
+      return c_.size ();
+    }
+
+    virtual const void*
+    element (std::size_t i) const
+    {
+      // Restart from the beginning if going backwards or starting over
+      // (the container could have been modified since the last time).
+      //
+      if (i == 0 || i < n_)
+      {
+        i_ = c_.begin ();
+        n_ = 0;
+      }
+
+      for (; n_ != i; ++n_)
+        ++i_;
+
+      // Compiler error pointing here? The container element type should
+      // be the same as the column type. Use the by-value in_range() if
+      // a conversion is required.
+      //
+      const T* r (&*i_);
+      return r;
+    }
+
+    virtual query_range_param*
+    clone () const
+    {
+      container_query_param* r (
+        new (details::shared) container_query_param (c_));
+      r->offset = offset;
+      r->count = count;
+      return r;
+    }
+
+  private:
+    const C& c_;
+    mutable typename C::const_iterator i_;
+    mutable std::size_t n_;
+  };
+
   // For by-value parameters we have to make a copy since the original
   // can be gone by the time we translate to native query.
   //
@@ -143,7 +243,13 @@ namespace odb
         op_lt,          // <
         op_gt,          // >
         op_le,          // <=
-        op_ge           // >=
+        op_ge,          // >=
+
+        // Kept last not to change the indexes of the above enumerators.
+        //
+        kind_param_range // data points to query_range_param while
+                         // native_info points to the native_column_info
+                         // array. Only used as the sole op_in argument.
       };
 
       kind_type kind;
@@ -151,6 +257,9 @@ namespace odb
       const native_column_info* native_info;
     };
 
+    typedef std::vector<clause_part> clause_type;
+    typedef std::vector<std::string> strings_type;
+
   public:
     ~query_base ()
     {
@@ -249,6 +358,69 @@ namespace odb
         clause_.front ().kind == clause_part::kind_true;
     }
 
+    // Structural fingerprint of the query. Two queries that only differ
+    // in parameter values (but not in columns, operators, native
+    // fragments, or parameter binding kinds) have the same structure
+    // and therefore translate to the same native statement text.
+    //
+    std::size_t
+    structure_hash () const;
+
+    bool
+    structure_equal (const query_base&) const;
+
+    // As above but for a clause given as an array of n parts with the
+    // native fragments in the strings vector (used by static queries,
+    // see query-static.hxx).
+    //
+    static std::size_t
+    structure_hash (const clause_part*, std::size_t n, const strings_type&);
+
+    bool
+    structure_equal (const clause_part*,
+                     std::size_t n,
+                     const strings_type&) const;
+
+    // Return a copy of this query with all the parameters stripped. The
+    // result can only be used for structural comparison and hashing.
+    //
+    query_base
+    structure () const;
+
+    // A large range bound by reference with in_range() can be split into
+    // chunks of at most n elements that are executed as separate
+    // statements with the results combined. This is only possible if
+    // the query has a single such range and its in_range() expression is
+    // a top-level conjunct (that is, it is not negated or part of a
+    // disjunction). Return the number of chunks (1 if no chunking is
+    // necessary or possible).
+    //
+    std::size_t
+    range_chunks (std::size_t n) const;
+
+    // Restrict the range to the i-th chunk of at most n elements. Passing
+    // 0 for n resets the range to the complete set of elements. The
+    // window is private to this query: a range parameter shared with
+    // a copy of the query is copied first.
+    //
+    void
+    range_chunk (std::size_t i, std::size_t n);
+
+    // Normalize the query by folding the true/false literals in logical
+    // expressions, removing double negations, arranging chains of the
+    // same logical operator into a canonical (left-associative) form,
+    // and removing duplicate in() arguments. Only arguments that refer
+    // to the same parameter (for example, the same by-reference variable)
+    // are considered duplicates since by-value parameters are opaque. An
+    // in() expression without arguments or with a by-reference range that
+    // is currently empty is replaced with false.
+    //
+    // The result is a shorter native query and, thanks to the canonical
+    // form, more hits in the query statement cache.
+    //
+    void
+    normalize ();
+
     // Implementation details.
     //
   public:
@@ -268,6 +440,11 @@ namespace odb
     void
     append (const query_base&);
 
+    // Sub-expression occupying the [begin, end) range of parts.
+    //
+    void
+    append (const query_base&, std::size_t begin, std::size_t end);
+
     // Operator.
     //
     void
@@ -297,13 +474,14 @@ namespace odb
     void
     append_val (const T& val, const native_column_info*);
 
+    template <typename T, typename C>
+    void
+    append_range (const C& container, const native_column_info*);
+
     void
     clear ();
 
   public:
-    typedef std::vector<clause_part> clause_type;
-    typedef std::vector<std::string> strings_type;
-
     const clause_type&
     clause () const
     {
@@ -417,6 +595,24 @@ namespace odb
     query_base
     in_range (I begin, I end) const;
 
+    // Bind the container by reference as a single parameter instead of
+    // one parameter per element. The container element type should be
+    // the column type and the container should not be modified while
+    // the query is executed. Large ranges are split into chunks (see
+    // query_base::range_chunks()) or bound as an array where supported
+    // by the database.
+    //
+    // The range is represented by the kind_param_range clause part which
+    // the database runtime must translate (one placeholder per element
+    // in the current window) before this function can be used with it.
+    // Since an empty range would result in the invalid IN () clause, the
+    // runtime should also normalize the query (see query_base::normalize())
+    // just before executing it, which folds such a range to false.
+    //
+    template <typename C>
+    query_base
+    in_range (ref_bind<C> container) const;
+
     // like
     //
   public:
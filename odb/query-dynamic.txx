@@ -23,6 +23,21 @@ namespace odb
     p.data = reinterpret_cast<std::size_t> (qp);
   }
 
+  template <typename T, typename C>
+  void query_base::
+  append_range (const C& c, const native_column_info* ci)
+  {
+    clause_.push_back (clause_part ());
+    clause_part& p (clause_.back ());
+
+    p.kind = clause_part::kind_param_range;
+    p.data = 0; // In case new below throws.
+    p.native_info = ci;
+
+    query_param* qp (new (details::shared) container_query_param<T, C> (c));
+    p.data = reinterpret_cast<std::size_t> (qp);
+  }
+
   //
   // query_column
   //
@@ -94,6 +109,17 @@ namespace odb
     return q;
   }
 
+  template <typename T>
+  template <typename C>
+  query_base query_column<T>::
+  in_range (ref_bind<C> c) const
+  {
+    query_base q (native_info);
+    q.append_range<T> (c.ref, native_info);
+    q.append (query_base::clause_part::op_in, 1);
+    return q;
+  }
+
   // like
   //
   template <typename T>
@@ -0,0 +1,311 @@
+// file      : odb/query-evaluator.cxx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#include <odb/exceptions.hxx>
+#include <odb/query-evaluator.hxx>
+
+using namespace std;
+
+namespace odb
+{
+  typedef query_base::clause_part clause_part;
+
+  // query_evaluator_base
+  //
+  query_evaluator_base::column_base::
+  ~column_base ()
+  {
+  }
+
+  query_evaluator_base::
+  ~query_evaluator_base ()
+  {
+    for (column_map::iterator i (columns_.begin ()); i != columns_.end (); ++i)
+      delete i->second;
+  }
+
+  void query_evaluator_base::
+  column_ (const native_column_info* c, column_base* x)
+  {
+    column_base*& r (columns_[c]);
+    delete r;
+    r = x;
+  }
+
+  const query_evaluator_base::column_base& query_evaluator_base::
+  find (const clause_part& x) const
+  {
+    if (x.kind != clause_part::kind_column)
+      throw query_not_evaluable ();
+
+    column_map::const_iterator i (columns_.find (x.native_info));
+
+    if (i == columns_.end ())
+      throw query_not_evaluable ();
+
+    return *i->second;
+  }
+
+  bool query_evaluator_base::
+  evaluate (const query_base& q, const void* o) const
+  {
+    // An empty query matches everything.
+    //
+    return q.empty () ||
+      evaluate (q, q.clause ().size () - 1, o) == truth_true;
+  }
+
+  // Return the value of the parameter part or, for a range, the range
+  // parameter itself.
+  //
+  static const void*
+  parameter (const clause_part& x)
+  {
+    if (x.kind != clause_part::kind_param_val &&
+        x.kind != clause_part::kind_param_ref &&
+        x.kind != clause_part::kind_param_range)
+      throw query_not_evaluable ();
+
+    const query_param* qp (reinterpret_cast<const query_param*> (x.data));
+
+    // Stripped parameter (see query_base::structure()).
+    //
+    if (qp == 0 || qp->value == 0)
+      throw query_not_evaluable ();
+
+    if (x.kind == clause_part::kind_param_range)
+      return qp;
+
+    return qp->value;
+  }
+
+  query_evaluator_base::truth query_evaluator_base::
+  evaluate (const query_base& q, size_t p, const void* o) const
+  {
+    const query_base::clause_type& cl (q.clause ());
+    const clause_part& x (cl[p]);
+
+    switch (x.kind)
+    {
+    case clause_part::kind_true:
+      return truth_true;
+
+    case clause_part::kind_false:
+      return truth_false;
+
+    case clause_part::op_and:
+      {
+        truth l (evaluate (q, x.data, o));
+
+        if (l == truth_false)
+          return truth_false;
+
+        truth r (evaluate (q, p - 1, o));
+
+        if (r == truth_false)
+          return truth_false;
+
+        return l == truth_true && r == truth_true
+          ? truth_true
+          : truth_unknown;
+      }
+    case clause_part::op_or:
+      {
+        truth l (evaluate (q, x.data, o));
+
+        if (l == truth_true)
+          return truth_true;
+
+        truth r (evaluate (q, p - 1, o));
+
+        if (r == truth_true)
+          return truth_true;
+
+        return l == truth_false && r == truth_false
+          ? truth_false
+          : truth_unknown;
+      }
+    case clause_part::op_not:
+      {
+        truth v (evaluate (q, p - 1, o));
+
+        return v == truth_unknown
+          ? truth_unknown
+          : (v == truth_true ? truth_false : truth_true);
+      }
+    case clause_part::op_null:
+    case clause_part::op_not_null:
+      {
+        bool n (find (cl[p - 1]).value (o) == 0);
+
+        return n == (x.kind == clause_part::op_null)
+          ? truth_true
+          : truth_false;
+      }
+    case clause_part::op_in:
+      {
+        const column_base& c (find (cl[p - x.data - 1]));
+        const void* v (c.value (o));
+
+        if (v == 0)
+          return truth_unknown;
+
+        for (size_t i (p - x.data); i != p; ++i)
+        {
+          if (cl[i].kind == clause_part::kind_param_range)
+          {
+            // Ignore the chunk window and use the whole range.
+            //
+            const query_range_param& r (
+              *reinterpret_cast<const query_range_param*> (parameter (cl[i])));
+
+            for (size_t j (0), n (r.size ()); j != n; ++j)
+            {
+              if (c.equal (v, r.element (j)))
+                return truth_true;
+            }
+          }
+          else if (c.equal (v, parameter (cl[i])))
+            return truth_true;
+        }
+
+        return truth_false;
+      }
+    case clause_part::op_like:
+    case clause_part::op_like_escape:
+      {
+        size_t b (p - (x.kind == clause_part::op_like ? 2 : 3));
+
+        const column_base& c (find (cl[b]));
+        const void* v (c.value (o));
+
+        if (v == 0)
+          return truth_unknown;
+
+        const void* e (x.kind == clause_part::op_like_escape
+                       ? parameter (cl[p - 1])
+                       : 0);
+
+        return c.like (v, parameter (cl[b + 1]), e)
+          ? truth_true
+          : truth_false;
+      }
+    case clause_part::op_eq:
+    case clause_part::op_ne:
+    case clause_part::op_lt:
+    case clause_part::op_gt:
+    case clause_part::op_le:
+    case clause_part::op_ge:
+      {
+        // The left hand side is always a column while the right hand
+        // side is either a parameter or another column, which should
+        // be of the same type.
+        //
+        const column_base& c (find (cl[x.data]));
+        const void* l (c.value (o));
+        const void* r;
+
+        if (cl[p - 1].kind == clause_part::kind_column)
+        {
+          const column_base& rc (find (cl[p - 1]));
+
+          if (rc.type () != c.type ())
+            throw query_not_evaluable ();
+
+          r = rc.value (o);
+        }
+        else
+          r = parameter (cl[p - 1]);
+
+        if (l == 0 || r == 0)
+          return truth_unknown;
+
+        bool v;
+        switch (x.kind)
+        {
+        case clause_part::op_eq: v = c.equal (l, r);  break;
+        case clause_part::op_ne: v = !c.equal (l, r); break;
+        case clause_part::op_lt: v = c.less (l, r);   break;
+        case clause_part::op_gt: v = c.less (r, l);   break;
+        case clause_part::op_le: v = !c.less (r, l);  break;
+        default:                 v = !c.less (l, r);  break; // op_ge
+        }
+
+        return v ? truth_true : truth_false;
+      }
+    case clause_part::kind_column:
+    case clause_part::kind_param_val:
+    case clause_part::kind_param_ref:
+    case clause_part::kind_param_range:
+    case clause_part::kind_native:
+    case clause_part::op_add:
+      break;
+    }
+
+    // Native SQL fragments, etc.
+    //
+    throw query_not_evaluable ();
+  }
+
+  // like
+  //
+  bool
+  like_match (const char* s, size_t sn, const char* p, size_t pn, char e)
+  {
+    // Greedy matching with backtracking to the last '%'.
+    //
+    size_t si (0), pi (0);
+    size_t bs (0), bp (0); // Backtrack positions.
+    bool bt (false);
+
+    while (si != sn)
+    {
+      if (pi != pn)
+      {
+        char c (p[pi]);
+
+        if (c == '%')
+        {
+          bp = ++pi;
+          bs = si;
+          bt = true;
+          continue;
+        }
+
+        bool esc (e != '\0' && c == e && pi + 1 != pn);
+
+        if (esc)
+          c = p[pi + 1];
+
+        if ((!esc && c == '_') || c == s[si])
+        {
+          pi += esc ? 2 : 1;
+          ++si;
+          continue;
+        }
+      }
+
+      if (!bt)
+        return false;
+
+      pi = bp;
+      si = ++bs;
+    }
+
+    // Only trailing '%' can match the empty remainder.
+    //
+    while (pi != pn && p[pi] == '%')
+      ++pi;
+
+    return pi == pn;
+  }
+
+  bool query_evaluator_like<string>::
+  like (const string& s, const string& p, const string* e)
+  {
+    return like_match (s.c_str (), s.size (),
+                       p.c_str (), p.size (),
+                       e != 0 && !e->empty () ? (*e)[0] : '\0');
+  }
+}
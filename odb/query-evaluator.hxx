@@ -0,0 +1,170 @@
+// file      : odb/query-evaluator.hxx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#ifndef ODB_QUERY_EVALUATOR_HXX
+#define ODB_QUERY_EVALUATOR_HXX
+
+#include <odb/pre.hxx>
+
+#include <map>
+#include <string>
+#include <cstddef>  // std::size_t
+#include <typeinfo>
+
+#include <odb/forward.hxx>
+#include <odb/query-dynamic.hxx>
+
+#include <odb/details/export.hxx>
+#include <odb/details/wrapper-p.hxx>
+
+namespace odb
+{
+  // Evaluate dynamic query predicates against in-memory objects, for
+  // example, to refine a query over the objects already loaded into a
+  // session or a cached query result without another database round
+  // trip.
+  //
+  // Query columns only carry the database-specific information so the
+  // data member corresponding to each column used in the query has to
+  // be registered with the evaluator. Queries that use unregistered
+  // columns, native SQL fragments, or operations that cannot be
+  // evaluated in memory (for example, like() for non-string types)
+  // cause the query_not_evaluable exception to be thrown.
+  //
+  // The evaluation follows the SQL three-valued logic: comparisons
+  // involving NULL values are neither true nor false and the predicate
+  // is only satisfied if it evaluates to true. Note also that the result
+  // may differ from the database if the database uses a different
+  // collation or case sensitivity for string comparison.
+  //
+  class LIBODB_EXPORT query_evaluator_base
+  {
+  public:
+    // Type-erased data member accessor. The values are passed as
+    // pointers to the column's C++ type.
+    //
+    struct LIBODB_EXPORT column_base
+    {
+      virtual
+      ~column_base ();
+
+      // Return a pointer to the member value or NULL if it is NULL.
+      //
+      virtual const void*
+      value (const void* object) const = 0;
+
+      virtual const std::type_info&
+      type () const = 0;
+
+      virtual bool
+      equal (const void* x, const void* y) const = 0;
+
+      virtual bool
+      less (const void* x, const void* y) const = 0;
+
+      // Escape is NULL if not specified.
+      //
+      virtual bool
+      like (const void* x, const void* pattern, const void* escape) const = 0;
+    };
+
+  public:
+    ~query_evaluator_base ();
+
+  protected:
+    query_evaluator_base () {}
+
+    bool
+    evaluate (const query_base&, const void* object) const;
+
+    // Takes ownership of the column object.
+    //
+    void
+    column_ (const native_column_info*, column_base*);
+
+  private:
+    query_evaluator_base (const query_evaluator_base&);
+    query_evaluator_base& operator= (const query_evaluator_base&);
+
+  private:
+    enum truth
+    {
+      truth_false,
+      truth_true,
+      truth_unknown
+    };
+
+    truth
+    evaluate (const query_base&, std::size_t, const void*) const;
+
+    const column_base&
+    find (const query_base::clause_part&) const;
+
+    typedef std::map<const native_column_info*, column_base*> column_map;
+    column_map columns_;
+  };
+
+  // Match the string against the SQL LIKE pattern with the '%' and '_'
+  // wildcards. The escape character is '\0' if there is none.
+  //
+  LIBODB_EXPORT bool
+  like_match (const char* s, std::size_t sn,
+              const char* p, std::size_t pn,
+              char escape);
+
+  // Customization point for the like() operation. By default it cannot
+  // be evaluated.
+  //
+  template <typename T>
+  struct query_evaluator_like
+  {
+    static bool
+    like (const T&, const T& pattern, const T* escape);
+  };
+
+  template <>
+  struct LIBODB_EXPORT query_evaluator_like<std::string>
+  {
+    static bool
+    like (const std::string&,
+          const std::string& pattern,
+          const std::string* escape);
+  };
+
+  template <typename O>
+  class query_evaluator: public query_evaluator_base
+  {
+  public:
+    typedef O object_type;
+
+    // Register the data member corresponding to the column. The member
+    // type should be the column type or a wrapper (e.g., odb::nullable)
+    // around it. The column type should be equality and less-than
+    // comparable.
+    //
+    template <typename T, typename M>
+    void
+    column (const query_column<T>&, M O::*member);
+
+    bool
+    operator() (const query_base& q, const object_type& o) const
+    {
+      return evaluate (q, &o);
+    }
+
+    // Copy objects from the [begin, end) range (for example, a cached
+    // result or objects stored in a session) that satisfy the predicate
+    // to the output iterator.
+    //
+    template <typename I, typename R>
+    R
+    filter (const query_base&, I begin, I end, R result) const;
+  };
+}
+
+#include <odb/query-evaluator.txx>
+
+#include <odb/post.hxx>
+
+#endif // ODB_QUERY_EVALUATOR_HXX
@@ -0,0 +1,110 @@
+// file      : odb/query-evaluator.txx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#include <odb/exceptions.hxx> // query_not_evaluable
+
+namespace odb
+{
+  template <typename T>
+  bool query_evaluator_like<T>::
+  like (const T&, const T&, const T*)
+  {
+    throw query_not_evaluable ();
+  }
+
+  // Data member accessors. Note that the pointer conversions below
+  // make sure the member (or wrapped) type is the column type.
+  //
+  template <typename O, typename T, typename M,
+            bool W = details::wrapper_p<M>::r>
+  struct query_evaluator_column: query_evaluator_base::column_base
+  {
+    explicit
+    query_evaluator_column (M O::*m): member (m) {}
+
+    virtual const void*
+    value (const void* o) const
+    {
+      const T* r (&(static_cast<const O*> (o)->*member));
+      return r;
+    }
+
+    virtual const std::type_info&
+    type () const
+    {
+      return typeid (T);
+    }
+
+    virtual bool
+    equal (const void* x, const void* y) const
+    {
+      return *static_cast<const T*> (x) == *static_cast<const T*> (y);
+    }
+
+    virtual bool
+    less (const void* x, const void* y) const
+    {
+      return *static_cast<const T*> (x) < *static_cast<const T*> (y);
+    }
+
+    virtual bool
+    like (const void* x, const void* p, const void* e) const
+    {
+      return query_evaluator_like<T>::like (*static_cast<const T*> (x),
+                                            *static_cast<const T*> (p),
+                                            static_cast<const T*> (e));
+    }
+
+    M O::*member;
+  };
+
+  template <typename O, typename T, typename M>
+  struct query_evaluator_column<O, T, M, true>:
+    query_evaluator_column<O, T, T, false>
+  {
+    typedef wrapper_traits<M> wtraits;
+
+    explicit
+    query_evaluator_column (M O::*m)
+        : query_evaluator_column<O, T, T, false> (0), member (m) {}
+
+    virtual const void*
+    value (const void* o) const
+    {
+      const M& m (static_cast<const O*> (o)->*member);
+
+      if (wtraits::get_null (m))
+        return 0;
+
+      const T* r (&wtraits::get_ref (m));
+      return r;
+    }
+
+    M O::*member;
+  };
+
+  template <typename O>
+  template <typename T, typename M>
+  void query_evaluator<O>::
+  column (const query_column<T>& c, M O::*m)
+  {
+    column_ (c.native_info, new query_evaluator_column<O, T, M> (m));
+  }
+
+  template <typename O>
+  template <typename I, typename R>
+  R query_evaluator<O>::
+  filter (const query_base& q, I b, I e, R r) const
+  {
+    for (; b != e; ++b)
+    {
+      const object_type& o (*b);
+
+      if (evaluate (q, &o))
+        *r++ = *b;
+    }
+
+    return r;
+  }
+}
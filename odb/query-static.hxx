@@ -0,0 +1,561 @@
+// file      : odb/query-static.hxx
+// copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
+// license   : GNU GPL v2; see accompanying LICENSE file
+
+#ifndef ODB_QUERY_STATIC_HXX
+#define ODB_QUERY_STATIC_HXX
+
+#include <odb/pre.hxx>
+
+#include <cstddef> // std::size_t
+
+#include <odb/forward.hxx>
+#include <odb/query-dynamic.hxx>
+
+namespace odb
+{
+  // Static queries. A static query is an expression template that is
+  // built from query columns wrapped with static_column(), for example:
+  //
+  // typedef odb::query<person> query;
+  //
+  // static_column (query::age) > 30 &&
+  // static_column (query::first) == query::_ref (name)
+  //
+  // Unlike the query_column operators which build the RPN representation
+  // (see query_base) on every call, the structure of a static query is
+  // encoded in its type. The number of clause parts and parameters as
+  // well as the positions of the operator arguments are compile-time
+  // constants and the parameters are stored in the expression object
+  // itself (by-value parameters are copied, by-reference ones are
+  // pointed to). As a result, the structural hash and comparison (see
+  // query_base::structure_hash()) as well as the binding of parameters
+  // do not allocate and the query can be used to look up a prepared
+  // statement in the connection's query statement cache directly. The
+  // dynamic query only needs to be materialized with query() to prepare
+  // the statement the first time.
+  //
+  // The structure of a static query is the same as that of the equivalent
+  // dynamic query so the two can be used interchangeably with the cache.
+  //
+  template <typename E>
+  struct static_query
+  {
+    typedef E expression_type;
+
+    const expression_type&
+    expression () const
+    {
+      return static_cast<const expression_type&> (*this);
+    }
+
+    std::size_t
+    structure_hash () const
+    {
+      query_base::clause_part p[expression_type::part_count];
+      expression ().parts (p, 0);
+      return query_base::structure_hash (
+        p, expression_type::part_count, query_base::strings_type ());
+    }
+
+    bool
+    structure_equal (const query_base& q) const
+    {
+      query_base::clause_part p[expression_type::part_count];
+      expression ().parts (p, 0);
+      return q.structure_equal (
+        p, expression_type::part_count, query_base::strings_type ());
+    }
+
+    // Store pointers to the parameter values, in the order they appear
+    // in the query, into the array which should have room for at least
+    // param_count elements.
+    //
+    void
+    params (const void** values) const
+    {
+      expression ().params (values);
+    }
+
+    // Materialize the equivalent dynamic query.
+    //
+    query_base
+    query () const
+    {
+      query_base q;
+      expression ().append (q);
+      return q;
+    }
+  };
+
+  namespace details
+  {
+    inline void
+    static_query_part (query_base::clause_part& p,
+                       query_base::clause_part::kind_type k,
+                       std::size_t data,
+                       const native_column_info* c)
+    {
+      p.kind = k;
+      p.data = data;
+      p.native_info = c;
+    }
+  }
+
+  // Parameters.
+  //
+  template <typename T>
+  struct static_query_val
+  {
+    static const query_base::clause_part::kind_type kind =
+      query_base::clause_part::kind_param_val;
+
+    explicit
+    static_query_val (const T& v): value (v) {}
+
+    const void*
+    ptr () const
+    {
+      return &value;
+    }
+
+    void
+    append (query_base& q, const native_column_info* c) const
+    {
+      q.append_val (value, c);
+    }
+
+    T value;
+  };
+
+  struct static_query_ref
+  {
+    static const query_base::clause_part::kind_type kind =
+      query_base::clause_part::kind_param_ref;
+
+    template <typename T>
+    explicit
+    static_query_ref (ref_bind<T> r): ref (r.ptr ()) {}
+
+    const void*
+    ptr () const
+    {
+      return ref;
+    }
+
+    void
+    append (query_base& q, const native_column_info* c) const
+    {
+      q.append_ref (ref, c);
+    }
+
+    const void* ref;
+  };
+
+  // Expressions. Each expression has the part_count and param_count
+  // constants as well as the following functions:
+  //
+  // parts (p, offset)  -- store the clause parts into the p array whose
+  //                       first element is at the offset position in
+  //                       the complete clause.
+  // params (values)    -- store pointers to the parameter values.
+  // append (q)         -- append the parts to the dynamic query.
+  //
+  template <query_base::clause_part::kind_type K, typename P>
+  struct static_query_compare: static_query<static_query_compare<K, P> >
+  {
+    static const std::size_t part_count = 3;
+    static const std::size_t param_count = 1;
+
+    static_query_compare (const native_column_info* c, const P& p)
+        : column (c), param (p) {}
+
+    void
+    parts (query_base::clause_part* p, std::size_t offset) const
+    {
+      details::static_query_part (
+        p[0], query_base::clause_part::kind_column, 0, column);
+      details::static_query_part (p[1], P::kind, 0, column);
+      details::static_query_part (p[2], K, offset, 0);
+    }
+
+    void
+    params (const void** v) const
+    {
+      v[0] = param.ptr ();
+    }
+
+    void
+    append (query_base& q) const
+    {
+      std::size_t b (q.clause ().size ());
+      q.append (column);
+      param.append (q, column);
+      q.append (K, b);
+    }
+
+    const native_column_info* column;
+    P param;
+  };
+
+  template <query_base::clause_part::kind_type K>
+  struct static_query_null: static_query<static_query_null<K> >
+  {
+    static const std::size_t part_count = 2;
+    static const std::size_t param_count = 0;
+
+    explicit
+    static_query_null (const native_column_info* c): column (c) {}
+
+    void
+    parts (query_base::clause_part* p, std::size_t) const
+    {
+      details::static_query_part (
+        p[0], query_base::clause_part::kind_column, 0, column);
+      details::static_query_part (p[1], K, 0, 0);
+    }
+
+    void
+    params (const void**) const
+    {
+    }
+
+    void
+    append (query_base& q) const
+    {
+      q.append (column);
+      q.append (K, 0);
+    }
+
+    const native_column_info* column;
+  };
+
+  template <typename T, std::size_t N>
+  struct static_query_in: static_query<static_query_in<T, N> >
+  {
+    static const std::size_t part_count = N + 2;
+    static const std::size_t param_count = N;
+
+    explicit
+    static_query_in (const native_column_info* c): column (c) {}
+
+    void
+    parts (query_base::clause_part* p, std::size_t) const
+    {
+      details::static_query_part (
+        p[0], query_base::clause_part::kind_column, 0, column);
+
+      for (std::size_t i (0); i != N; ++i)
+        details::static_query_part (
+          p[i + 1], query_base::clause_part::kind_param_val, 0, column);
+
+      details::static_query_part (
+        p[N + 1], query_base::clause_part::op_in, N, 0);
+    }
+
+    void
+    params (const void** v) const
+    {
+      for (std::size_t i (0); i != N; ++i)
+        v[i] = &values[i];
+    }
+
+    void
+    append (query_base& q) const
+    {
+      q.append (column);
+
+      for (std::size_t i (0); i != N; ++i)
+        q.append_val (values[i], column);
+
+      q.append (query_base::clause_part::op_in, N);
+    }
+
+    const native_column_info* column;
+    T values[N];
+  };
+
+  template <query_base::clause_part::kind_type K, typename L, typename R>
+  struct static_query_binary: static_query<static_query_binary<K, L, R> >
+  {
+    static const std::size_t part_count =
+      L::part_count + R::part_count + 1;
+    static const std::size_t param_count =
+      L::param_count + R::param_count;
+
+    static_query_binary (const L& l, const R& r): left (l), right (r) {}
+
+    void
+    parts (query_base::clause_part* p, std::size_t offset) const
+    {
+      left.parts (p, offset);
+      right.parts (p + L::part_count, offset + L::part_count);
+      details::static_query_part (
+        p[part_count - 1], K, offset + L::part_count - 1, 0);
+    }
+
+    void
+    params (const void** v) const
+    {
+      left.params (v);
+      right.params (v + L::param_count);
+    }
+
+    void
+    append (query_base& q) const
+    {
+      left.append (q);
+      std::size_t l (q.clause ().size () - 1);
+      right.append (q);
+      q.append (K, l);
+    }
+
+    L left;
+    R right;
+  };
+
+  template <typename E>
+  struct static_query_not: static_query<static_query_not<E> >
+  {
+    static const std::size_t part_count = E::part_count + 1;
+    static const std::size_t param_count = E::param_count;
+
+    explicit
+    static_query_not (const E& e): expr (e) {}
+
+    void
+    parts (query_base::clause_part* p, std::size_t offset) const
+    {
+      expr.parts (p, offset);
+      details::static_query_part (
+        p[part_count - 1], query_base::clause_part::op_not, 0, 0);
+    }
+
+    void
+    params (const void** v) const
+    {
+      expr.params (v);
+    }
+
+    void
+    append (query_base& q) const
+    {
+      expr.append (q);
+      q.append (query_base::clause_part::op_not, 0);
+    }
+
+    E expr;
+  };
+
+  template <typename L, typename R>
+  inline static_query_binary<query_base::clause_part::op_and, L, R>
+  operator&& (const static_query<L>& x, const static_query<R>& y)
+  {
+    return static_query_binary<query_base::clause_part::op_and, L, R> (
+      x.expression (), y.expression ());
+  }
+
+  template <typename L, typename R>
+  inline static_query_binary<query_base::clause_part::op_or, L, R>
+  operator|| (const static_query<L>& x, const static_query<R>& y)
+  {
+    return static_query_binary<query_base::clause_part::op_or, L, R> (
+      x.expression (), y.expression ());
+  }
+
+  template <typename E>
+  inline static_query_not<E>
+  operator! (const static_query<E>& x)
+  {
+    return static_query_not<E> (x.expression ());
+  }
+
+  // Query column wrapper that produces static query expressions. Note
+  // that the column should be on the left hand side of comparisons.
+  //
+  template <typename T>
+  struct static_query_column
+  {
+    typedef query_base::clause_part part;
+    typedef static_query_val<T> val_type;
+    typedef static_query_ref ref_type;
+
+    explicit
+    static_query_column (const query_column<T>& c)
+        : native_info (c.native_info) {}
+
+    // is_null, is_not_null
+    //
+  public:
+    static_query_null<part::op_null>
+    is_null () const
+    {
+      return static_query_null<part::op_null> (native_info);
+    }
+
+    static_query_null<part::op_not_null>
+    is_not_null () const
+    {
+      return static_query_null<part::op_not_null> (native_info);
+    }
+
+    // in
+    //
+  public:
+    static_query_in<T, 2>
+    in (const T& v1, const T& v2) const
+    {
+      static_query_in<T, 2> r (native_info);
+      r.values[0] = v1;
+      r.values[1] = v2;
+      return r;
+    }
+
+    static_query_in<T, 3>
+    in (const T& v1, const T& v2, const T& v3) const
+    {
+      static_query_in<T, 3> r (native_info);
+      r.values[0] = v1;
+      r.values[1] = v2;
+      r.values[2] = v3;
+      return r;
+    }
+
+    static_query_in<T, 4>
+    in (const T& v1, const T& v2, const T& v3, const T& v4) const
+    {
+      static_query_in<T, 4> r (native_info);
+      r.values[0] = v1;
+      r.values[1] = v2;
+      r.values[2] = v3;
+      r.values[3] = v4;
+      return r;
+    }
+
+    static_query_in<T, 5>
+    in (const T& v1, const T& v2, const T& v3, const T& v4, const T& v5) const
+    {
+      static_query_in<T, 5> r (native_info);
+      r.values[0] = v1;
+      r.values[1] = v2;
+      r.values[2] = v3;
+      r.values[3] = v4;
+      r.values[4] = v5;
+      return r;
+    }
+
+    // Comparison.
+    //
+  public:
+    template <part::kind_type K>
+    static_query_compare<K, val_type>
+    compare (const T& v) const
+    {
+      return static_query_compare<K, val_type> (native_info, val_type (v));
+    }
+
+    template <part::kind_type K>
+    static_query_compare<K, ref_type>
+    compare (ref_bind<T> r) const
+    {
+      return static_query_compare<K, ref_type> (native_info, ref_type (r));
+    }
+
+    // ==
+    //
+    friend static_query_compare<part::op_eq, val_type>
+    operator== (const static_query_column& c, const T& v)
+    {
+      return c.template compare<part::op_eq> (v);
+    }
+
+    friend static_query_compare<part::op_eq, ref_type>
+    operator== (const static_query_column& c, ref_bind<T> r)
+    {
+      return c.template compare<part::op_eq> (r);
+    }
+
+    // !=
+    //
+    friend static_query_compare<part::op_ne, val_type>
+    operator!= (const static_query_column& c, const T& v)
+    {
+      return c.template compare<part::op_ne> (v);
+    }
+
+    friend static_query_compare<part::op_ne, ref_type>
+    operator!= (const static_query_column& c, ref_bind<T> r)
+    {
+      return c.template compare<part::op_ne> (r);
+    }
+
+    // <
+    //
+    friend static_query_compare<part::op_lt, val_type>
+    operator< (const static_query_column& c, const T& v)
+    {
+      return c.template compare<part::op_lt> (v);
+    }
+
+    friend static_query_compare<part::op_lt, ref_type>
+    operator< (const static_query_column& c, ref_bind<T> r)
+    {
+      return c.template compare<part::op_lt> (r);
+    }
+
+    // >
+    //
+    friend static_query_compare<part::op_gt, val_type>
+    operator> (const static_query_column& c, const T& v)
+    {
+      return c.template compare<part::op_gt> (v);
+    }
+
+    friend static_query_compare<part::op_gt, ref_type>
+    operator> (const static_query_column& c, ref_bind<T> r)
+    {
+      return c.template compare<part::op_gt> (r);
+    }
+
+    // <=
+    //
+    friend static_query_compare<part::op_le, val_type>
+    operator<= (const static_query_column& c, const T& v)
+    {
+      return c.template compare<part::op_le> (v);
+    }
+
+    friend static_query_compare<part::op_le, ref_type>
+    operator<= (const static_query_column& c, ref_bind<T> r)
+    {
+      return c.template compare<part::op_le> (r);
+    }
+
+    // >=
+    //
+    friend static_query_compare<part::op_ge, val_type>
+    operator>= (const static_query_column& c, const T& v)
+    {
+      return c.template compare<part::op_ge> (v);
+    }
+
+    friend static_query_compare<part::op_ge, ref_type>
+    operator>= (const static_query_column& c, ref_bind<T> r)
+    {
+      return c.template compare<part::op_ge> (r);
+    }
+
+    const native_column_info* native_info;
+  };
+
+  template <typename T>
+  inline static_query_column<T>
+  static_column (const query_column<T>& c)
+  {
+    return static_query_column<T> (c);
+  }
+}
+
+#include <odb/post.hxx>
+
+#endif // ODB_QUERY_STATIC_HXX
@@ -80,11 +80,23 @@ namespace odb
       state_.loaded = l;
       state_.changed = c;
 
-      if (t != 0 && !state_.armed)
+      if (t != 0 && t->read_only ())
+        t = 0;
+
+      if (t != 0)
       {
-        t->callback_register (&transacion_callback,
-                              const_cast<section*> (this));
-        state_.armed = 1;
+        // If already armed, then re-arm the callback so that it belongs
+        // to the current savepoint scope.
+        //
+        if (state_.armed)
+          t->callback_update (const_cast<section*> (this),
+                              transaction::event_all);
+        else
+        {
+          t->callback_register (&transacion_callback,
+                                const_cast<section*> (this));
+          state_.armed = 1;
+        }
       }
 
       state_.restore = (t != 0);
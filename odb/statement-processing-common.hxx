@@ -17,6 +17,10 @@ namespace odb
 {
   typedef std::char_traits<char> traits;
 
+  // Note that the forward scanners are implemented in terms of
+  // traits::find() which maps to memchr() and is vectorized by the C
+  // library on mainstream platforms.
+  //
   static inline const char*
   find (const char* b, const char* e, char c)
   {
@@ -36,11 +40,15 @@ namespace odb
   static inline const char*
   find (const char* b, const char* e, const char* s, std::size_t n)
   {
-    for (; b != e; ++b)
+    if (static_cast<std::size_t> (e - b) < n)
+      return 0;
+
+    // Only look for the first character where the whole string can still
+    // fit and skip to its occurrences.
+    //
+    for (const char* l (e - n + 1); (b = find (b, l, *s)) != 0; ++b)
     {
-      if (*b == *s &&
-          static_cast<std::size_t> (e - b) >= n &&
-          traits::compare (b, s, n) == 0)
+      if (traits::compare (b + 1, s + 1, n - 1) == 0)
         return b;
     }
 
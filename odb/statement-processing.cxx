@@ -2,6 +2,7 @@
 // copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
 // license   : GNU GPL v2; see accompanying LICENSE file
 
+#include <vector>
 #include <cassert>
 
 #include <odb/statement-processing-common.hxx>
@@ -12,6 +13,7 @@
 
 #include <odb/statement.hxx>
 
+
 using namespace std;
 
 namespace odb
@@ -399,6 +401,64 @@ namespace odb
 #endif
   }
 
+  // Return true if the alias is used as a qualifier in the text. To make
+  // it more robust, we are going to do a few extra sanity checks,
+  // specifically, that the alias is a top level identifier and is followed
+  // by only a single identifer (column). This will catch cases like
+  // [s].[t].[c] where [s] is also used as an alias or LEFT JOIN [t] where
+  // [t] is also used as an alias in another JOIN.
+  //
+  static bool
+  alias_used (const char* r, size_t n,
+              const char* a, size_t an,
+              char quote_open, char quote_close)
+  {
+    const char* end (r + n);
+
+    for (const char* b (find (r, end, a, an));
+         b != 0;
+         b = find (b + an, end, a, an))
+    {
+      size_t p (b - r), e (p + an);
+
+      // If we are not a top-level qualifier or not a bottom-level,
+      // then we are done (3 is for at least "[a]").
+      //
+      if ((p != 0 && r[p - 1] == '.') ||
+          (e + 3 >= n || (r[e] != '.' || r[e + 1] != quote_open)))
+        continue;
+
+      // The only way to distinguish the [a].[c] from FROM [a].[c] or
+      // JOIN [a].[c] is by checking the prefix.
+      //
+      if ((p >= 5 && traits::compare (b - 5, "FROM ", 5) == 0) ||
+          (p >= 5 && traits::compare (b - 5, "JOIN ", 5) == 0))
+        continue;
+
+      // Check that we are followed by a single identifier.
+      //
+      const char* c (find (r + e + 2, end, quote_close));
+      if (c == 0 || (c + 1 != end && *(c + 1) == '.'))
+        continue;
+
+      return true;
+    }
+
+    return false;
+  }
+
+  // JOIN that has been dropped by process_select() but may still need
+  // to be restored.
+  //
+  struct dropped_join
+  {
+    size_t pos;        // Position of the JOIN area in the result.
+    const char* text;  // NULL if restored.
+    size_t size;
+    const char* alias;
+    size_t alias_size;
+  };
+
   void statement::
   process_select (const char* s,
                   bind_type bind,
@@ -571,8 +631,15 @@ namespace odb
     //
     if (joins_begin != 0)
     {
-      // Splice the JOINs into the pre-allocated area.
+      // Splice the JOINs into the pre-allocated area going from the last
+      // to the first. Use the stack for the dropped JOINs unless there
+      // are too many of them.
       //
+      const size_t dropped_cap (16);
+      dropped_join dropped_buf[dropped_cap];
+      vector<dropped_join> dropped_vec;
+      size_t dropped_n (0);
+
       for (const char* je (joins_end), *j (newline_rbegin (je, joins_begin));
            j != 0; newline_rnext (j, je, joins_begin))
       {
@@ -623,57 +690,991 @@ namespace odb
         // Instead of re-parsing the whole thing again, we are going to
         // take a shortcut and simply search for the alias in the statement
         // we have constructed so far (that's why we have added the
-        // trailer before filling in the JOINs). To make it more robust,
-        // we are going to do a few extra sanity checks, specifically,
-        // that the alias is a top level identifier and is followed by
-        // only a single identifer (column). This will catch cases like
-        // [s].[t].[c] where [s] is also used as an alias or LEFT JOIN [t]
-        // where [t] is also used as an alias in another JOIN.
+        // trailer before filling in the JOINs).
         //
-        bool found (false);
-        for (size_t p (r.find (alias_begin, 0, alias_size));
-             p != string::npos;
-             p = r.find (alias_begin, p + alias_size, alias_size))
+        bool found (alias_used (r.c_str (), r.size (),
+                                alias_begin, alias_size,
+                                quote_open, quote_close));
+
+        join_pos -= n + 1; // Extra one for space.
+        if (found)
+          r.replace (join_pos, n, j, n);
+        else
+        {
+          // Leave the area filled with spaces for now.
+          //
+          dropped_join d = {join_pos, j, n, alias_begin, alias_size};
+
+          if (dropped_vec.empty () && dropped_n != dropped_cap)
+            dropped_buf[dropped_n] = d;
+          else
+          {
+            if (dropped_vec.empty ())
+              dropped_vec.assign (dropped_buf, dropped_buf + dropped_n);
+
+            dropped_vec.push_back (d);
+          }
+
+          dropped_n++;
+        }
+      }
+
+      // A JOIN can also be referred to from the ON condition of a JOIN
+      // that precedes it, in which case it was dropped above. So keep
+      // restoring the dropped JOINs that are referred to from the ones
+      // that are kept until there are no more changes. Go from the first
+      // to the last so that a chain of such references is restored in a
+      // single iteration.
+      //
+      dropped_join* ds (dropped_vec.empty () ? dropped_buf : &dropped_vec[0]);
+
+      for (bool changed (dropped_n != 0); changed;)
+      {
+        changed = false;
+
+        for (size_t i (dropped_n); i != 0;)
         {
-          size_t e (p + alias_size);
+          dropped_join& d (ds[--i]);
+
+          if (d.text != 0 &&
+              alias_used (r.c_str (), r.size (),
+                          d.alias, d.alias_size,
+                          quote_open, quote_close))
+          {
+            r.replace (d.pos, d.size, d.text, d.size);
+            d.text = 0;
+            changed = true;
+          }
+        }
+      }
+
+      // Remove the areas of the JOINs that are still dropped. They were
+      // recorded from the last to the first so the positions of the ones
+      // that follow remain valid.
+      //
+      for (size_t i (0); i != dropped_n; ++i)
+      {
+        if (ds[i].text != 0)
+          r.erase (ds[i].pos - 1, ds[i].size + 1); // Extra one for space.
+      }
+    }
+
+#ifdef LIBODB_TRACE_STATEMENT_PROCESSING
+    if (r.size () != n)
+      cerr << endl
+           << "old: '" << s << "'" << endl << endl
+           << "new: '" << r << "'" << endl << endl;
+#endif
+  }
+
+
+  // Precompiled layout.
+  //
+  static inline statement::layout::range
+  make_range (const char* s, const char* b, const char* e)
+  {
+    statement::layout::range r;
+    r.begin = b - s;
+    r.size = e - b;
+    return r;
+  }
+
+  static void
+  compile_fast (statement::layout& l)
+  {
+    process_fast (l.statement, l.fast);
+  }
+
+  void statement::
+  compile_insert (const char* s, char param_symbol, layout& l)
+  {
+    l.kind = layout::kind_insert;
+    l.statement = s;
+    l.size = traits::length (s);
+    l.binds = 0;
+    l.values = false;
+    l.header = l.output = l.from = l.trailer = layout::range ();
+    l.elements.clear ();
+    l.joins.clear ();
+
+    const char* e (s + l.size);
+
+    // Header.
+    //
+    const char* p (find (s, e, '\n'));
+    assert (p != 0);
+    l.header = make_range (s, s, p);
+    p++;
+
+    // Column list.
+    //
+    if (*p == '(')
+    {
+      for (const char* ce (paren_begin (p, e)); ce != 0; paren_next (p, ce, e))
+      {
+        layout::element x;
+        x.text = make_range (s, p, ce);
+        x.bind = ~size_t (0);
+        l.elements.push_back (x);
+      }
+    }
+
+    // OUTPUT
+    //
+    if (e - p > 7 && traits::compare (p, "OUTPUT ", 7) == 0)
+    {
+      const char* b (p);
+      p = find (p + 7, e, '\n');
+      assert (p != 0);
+      l.output = make_range (s, b, p);
+      p++;
+    }
+
+    // VALUES or DEFAULT VALUES
+    //
+    if (e - p > 7 && traits::compare (p, "VALUES\n", 7) == 0)
+    {
+      p += 7;
+      l.values = true;
+
+      size_t i (0);
+      for (const char* ve (paren_begin (p, e));
+           ve != 0; paren_next (p, ve, e), ++i)
+      {
+        assert (i < l.elements.size ());
+        layout::element& x (l.elements[i]);
+
+        x.value = make_range (s, p, ve);
+
+        if (find (p, ve, param_symbol) != 0)
+          x.bind = l.binds++;
+      }
+    }
+    else
+    {
+      // Must be DEFAULT VALUES.
+      //
+      assert (traits::compare (p, "DEFAULT VALUES", 14) == 0);
+      p += 14;
+
+      if (*p == '\n')
+        p++;
+
+      l.elements.clear ();
+    }
 
-          // If we are not a top-level qualifier or not a bottom-level,
-          // then we are done (3 is for at least "[a]").
+    // Trailer.
+    //
+    l.trailer = make_range (s, p, e);
+
+    compile_fast (l);
+  }
+
+  void statement::
+  compile_update (const char* s, char param_symbol, layout& l)
+  {
+    l.kind = layout::kind_update;
+    l.statement = s;
+    l.size = traits::length (s);
+    l.binds = 0;
+    l.values = false;
+    l.header = l.output = l.from = l.trailer = layout::range ();
+    l.elements.clear ();
+    l.joins.clear ();
+
+    const char* e (s + l.size);
+
+    // Header.
+    //
+    const char* p (find (s, e, '\n'));
+    assert (p != 0);
+    l.header = make_range (s, s, p);
+    p++;
+
+    // SET
+    //
+    if (e - p > 4 && traits::compare (p, "SET\n", 4) == 0)
+    {
+      p += 4;
+
+      for (const char* pe (comma_begin (p, e)); pe != 0; comma_next (p, pe, e))
+      {
+        layout::element x;
+        x.text = make_range (s, p, pe);
+        x.bind = find (p, pe, param_symbol) != 0 ? l.binds++ : ~size_t (0);
+        l.elements.push_back (x);
+      }
+    }
+
+    // Trailer.
+    //
+    l.trailer = make_range (s, p, e);
+
+    compile_fast (l);
+  }
+
+  void statement::
+  compile_select (const char* s,
+                  char quote_open,
+                  char quote_close,
+                  layout& l,
+                  bool as)
+  {
+    l.kind = layout::kind_select;
+    l.statement = s;
+    l.size = traits::length (s);
+    l.binds = 0;
+    l.values = false;
+    l.header = l.output = l.from = l.trailer = layout::range ();
+    l.elements.clear ();
+    l.joins.clear ();
+
+    const char* e (s + l.size);
+
+    // Header.
+    //
+    const char* p (find (s, e, '\n'));
+    assert (p != 0);
+    l.header = make_range (s, s, p);
+    p++;
+
+    // Column list.
+    //
+    for (const char* ce (comma_begin (p, e)); ce != 0; comma_next (p, ce, e))
+    {
+      layout::element x;
+      x.text = make_range (s, p, ce);
+      x.bind = l.binds++;
+      l.elements.push_back (x);
+    }
+
+    // FROM.
+    //
+    assert (traits::compare (p, "FROM ", 5) == 0);
+    {
+      const char* b (p);
+      p = find (p, e, '\n'); // May not end with '\n'.
+      if (p == 0)
+        p = e;
+      l.from = make_range (s, b, p);
+      if (p != e)
+        p++;
+    }
+
+    // JOIN list.
+    //
+    vector<layout::range> aliases;
+
+    if (e - p > 5 && fuzzy_prefix (p, e, "JOIN ", 5))
+    {
+      for (const char* je (newline_begin (p, e));
+           je != 0; newline_next (p, je, e, "JOIN ", 5, true))
+      {
+        layout::join j;
+        j.text = make_range (s, p, je);
+        j.fixed = false;
+
+        // Get the alias or, if none used, the table name.
+        //
+        const char* b (find (p, je, "JOIN ", 5) + 5); // Skip past "JOIN ".
+        const char* table_begin (b);
+        b = find (b, je, ' '); // End of the table name.
+        const char* table_end (b);
+        b++; // Skip space.
+
+        const char* alias_begin (0);
+        const char* alias_end (0);
+
+        if (b != je && // Not the end.
+            (je - b < 4 || traits::compare (b, "ON ", 3) != 0))
+        {
+          // Something other than "ON ", so got to be an alias.
           //
-          if ((p != 0 && r[p - 1] == '.') ||
-              (e + 3 >= r.size () || (r[e] != '.' || r[e + 1] != quote_open)))
-            continue;
+          if (as)
+            b += 3;
 
-          // The only way to distinguish the [a].[c] from FROM [a].[c] or
-          // JOIN [a].[c] is by checking the prefix.
+          alias_begin = b;
+          b = find (b, je, ' '); // There might be no ON (CROSS JOIN).
+          alias_end = (b != 0 ? b : je);
+        }
+        else
+        {
+          // Just the table.
           //
-          if ((p > 5 && r.compare (p - 5, 5, "FROM ") == 0) ||
-              (p > 5 && r.compare (p - 5, 5, "JOIN ") == 0))
+          alias_begin = table_begin;
+          alias_end = table_end;
+        }
+
+        // The alias must be quoted.
+        //
+        assert (*alias_begin == quote_open && *(alias_end - 1) == quote_close);
+
+        aliases.push_back (make_range (s, alias_begin, alias_end));
+        l.joins.push_back (j);
+      }
+    }
+
+    // Trailer (WHERE, ORDER BY, etc).
+    //
+    l.trailer = make_range (s, p, e);
+
+    // Record the references to each JOIN alias (see process_select() for
+    // details on the matching).
+    //
+    for (size_t i (0); i != l.joins.size (); ++i)
+    {
+      layout::join& j (l.joins[i]);
+      const char* a (s + aliases[i].begin);
+      size_t an (aliases[i].size);
+
+      j.fixed =
+        alias_used (s + l.header.begin, l.header.size,
+                    a, an, quote_open, quote_close) ||
+        alias_used (s + l.from.begin, l.from.size,
+                    a, an, quote_open, quote_close) ||
+        alias_used (s + l.trailer.begin, l.trailer.size,
+                    a, an, quote_open, quote_close);
+
+      for (size_t k (0); k != l.elements.size (); ++k)
+      {
+        const layout::range& t (l.elements[k].text);
+
+        if (alias_used (s + t.begin, t.size, a, an, quote_open, quote_close))
+          j.columns.push_back (k);
+      }
+
+      for (size_t k (0); k != l.joins.size (); ++k)
+      {
+        const layout::range& t (l.joins[k].text);
+
+        if (k != i &&
+            alias_used (s + t.begin, t.size, a, an, quote_open, quote_close))
+          j.joins.push_back (k);
+      }
+    }
+
+    compile_fast (l);
+  }
+
+  // Output into a character array that is at least layout_bound() long.
+  //
+  struct array_splice
+  {
+    explicit
+    array_splice (char* b): b_ (b), p_ (b) {}
+
+    void
+    append (const char* s, size_t n)
+    {
+      traits::copy (p_, s, n);
+      p_ += n;
+    }
+
+    void
+    append (const char* s, const statement::layout::range& x)
+    {
+      append (s + x.begin, x.size);
+    }
+
+    void
+    append (char c)
+    {
+      *p_++ = c;
+    }
+
+    // Terminate and return the size.
+    //
+    size_t
+    end ()
+    {
+      *p_ = '\0';
+      return p_ - b_;
+    }
+
+    const char*
+    data () const
+    {
+      return b_;
+    }
+
+  private:
+    char* b_;
+    char* p_;
+  };
+
+  // Output into a string that has been reserved layout_bound() long.
+  //
+  struct string_splice
+  {
+    explicit
+    string_splice (string& s): s_ (s) {}
+
+    void
+    append (const char* s, size_t n)
+    {
+      s_.append (s, n);
+    }
+
+    void
+    append (const char* s, const statement::layout::range& x)
+    {
+      s_.append (s + x.begin, x.size);
+    }
+
+    void
+    append (char c)
+    {
+      s_ += c;
+    }
+
+    size_t
+    end ()
+    {
+      return s_.size ();
+    }
+
+    const char*
+    data () const
+    {
+      return s_.c_str ();
+    }
+
+  private:
+    string& s_;
+  };
+
+  // Upper bound on the processed statement size including the terminating
+  // '\0'. The result can only grow compared to the original in the INSERT
+  // DEFAULT VALUES case.
+  //
+  static inline size_t
+  layout_bound (const statement::layout& l)
+  {
+    return l.size + 16; // For " DEFAULT VALUES" and '\0'.
+  }
+
+  template <typename S>
+  static size_t
+  process_layout (const statement::layout& l,
+                  bind_type bind,
+                  size_t bind_size,
+                  size_t bind_skip,
+                  S& r,
+                  bool optimize)
+  {
+    typedef statement::layout layout;
+
+    const char* s (l.statement);
+    const layout::element* eb (l.elements.empty () ? 0 : &l.elements[0]);
+    const layout::element* ee (eb + l.elements.size ());
+
+    bool empty (true); // Empty case (if none present).
+    bool fast (true);  // Fast case (if all present).
+    for (size_t i (0); i != bind_size && (empty || fast); ++i)
+    {
+      if (bind_at (i, bind, bind_skip) != 0)
+        empty = false;
+      else
+        fast = false;
+    }
+
+#ifdef LIBODB_DEBUG_STATEMENT_PROCESSING
+    fast = false;
+#endif
+
+    switch (l.kind)
+    {
+    case layout::kind_insert:
+      {
+        if (fast)
+        {
+          r.append (l.fast.c_str (), l.fast.size ());
+          return r.end ();
+        }
+
+        // We cannot be empty if we have a non-parameterized value or if
+        // this value is present in the bind array.
+        //
+        empty = true;
+        for (const layout::element* x (eb); x != ee && empty; ++x)
+        {
+          if (x->bind == ~size_t (0) ||
+              bind_at (x->bind, bind, bind_skip) != 0)
+            empty = false;
+        }
+
+        r.append (s, l.header);
+
+        if (!empty)
+        {
+          r.append (' ');
+
+          size_t i (0);
+          for (const layout::element* x (eb); x != ee; ++x)
+          {
+            if (x->bind != ~size_t (0) &&
+                bind_at (x->bind, bind, bind_skip) == 0)
+              continue;
+
+            if (i++ == 0)
+              r.append ('(');
+            else
+              r.append (", ", 2);
+
+            r.append (s, x->text);
+          }
+
+          r.append (')');
+        }
+
+        if (l.output.size != 0)
+        {
+          r.append (' ');
+          r.append (s, l.output);
+        }
+
+        if (empty)
+          r.append (" DEFAULT VALUES", 15);
+        else
+        {
+          r.append (" VALUES ", 8);
+
+          size_t i (0);
+          for (const layout::element* x (eb); x != ee; ++x)
+          {
+            if (x->bind != ~size_t (0) &&
+                bind_at (x->bind, bind, bind_skip) == 0)
+              continue;
+
+            if (i++ == 0)
+              r.append ('(');
+            else
+              r.append (", ", 2);
+
+            r.append (s, x->value);
+          }
+
+          r.append (')');
+        }
+
+        break;
+      }
+    case layout::kind_update:
+      {
+        if (fast)
+        {
+          r.append (l.fast.c_str (), l.fast.size ());
+          return r.end ();
+        }
+
+        // We cannot be empty if we have a non-parameterized expression or
+        // if this expression is present in the bind array.
+        //
+        empty = true;
+        for (const layout::element* x (eb); x != ee && empty; ++x)
+        {
+          if (x->bind == ~size_t (0) ||
+              bind_at (x->bind, bind, bind_skip) != 0)
+            empty = false;
+        }
+
+        if (empty)
+          return r.end ();
+
+        r.append (s, l.header);
+        r.append (" SET ", 5);
+
+        size_t i (0);
+        for (const layout::element* x (eb); x != ee; ++x)
+        {
+          if (x->bind != ~size_t (0) &&
+              bind_at (x->bind, bind, bind_skip) == 0)
             continue;
 
-          // Check that we are followed by a single identifier.
-          //
-          e = r.find (quote_close, e + 2);
-          if (e == string::npos || (e + 1 != r.size () && r[e + 1] == '.'))
+          if (i++ != 0)
+            r.append (", ", 2);
+
+          r.append (s, x->text);
+        }
+
+        break;
+      }
+    case layout::kind_select:
+      {
+        if (empty)
+          return r.end ();
+
+        if (fast && (!optimize || l.joins.empty ()))
+        {
+          r.append (l.fast.c_str (), l.fast.size ());
+          return r.end ();
+        }
+
+        r.append (s, l.header);
+        r.append (' ');
+
+        size_t i (0);
+        for (const layout::element* x (eb); x != ee; ++x)
+        {
+          if (bind_at (x->bind, bind, bind_skip) == 0)
             continue;
 
-          found = true;
-          break;
+          if (i++ != 0)
+            r.append (", ", 2);
+
+          r.append (s, x->text);
         }
 
-        join_pos -= n + 1; // Extra one for space.
-        if (found)
-          r.replace (join_pos, n, j, n);
-        else
-          r.erase (join_pos - 1, n + 1); // Extra one for space.
+        r.append (' ');
+        r.append (s, l.from);
+
+        // Decide which JOINs to keep. A JOIN is kept if its alias is
+        // referred to from the header, FROM, the trailer, or one of the
+        // present columns, as well as if it is referred to from the ON
+        // condition of another JOIN that is kept. The latter is resolved
+        // by iterating to a fixed point which removes whole chains of
+        // unused JOINs regardless of the order in which they appear. Use
+        // the stack for the flags unless there are too many JOINs.
+        //
+        size_t n (l.joins.size ());
+
+        char keep_buf[64];
+        vector<char> keep_vec;
+        char* keep (keep_buf);
+
+        if (n > sizeof (keep_buf))
+        {
+          keep_vec.resize (n);
+          keep = &keep_vec[0];
+        }
+
+        for (size_t j (0); j != n; ++j)
+        {
+          const layout::join& x (l.joins[j]);
+          bool k (x.fixed);
+
+          for (size_t c (0); !k && c != x.columns.size (); ++c)
+            k = bind_at (l.elements[x.columns[c]].bind, bind, bind_skip) != 0;
+
+          keep[j] = k ? 1 : 0;
+        }
+
+        for (bool changed (true); changed;)
+        {
+          changed = false;
+
+          for (size_t j (0); j != n; ++j)
+          {
+            if (keep[j])
+              continue;
+
+            const layout::join& x (l.joins[j]);
+
+            for (size_t c (0); c != x.joins.size (); ++c)
+            {
+              if (keep[x.joins[c]])
+              {
+                keep[j] = 1;
+                changed = true;
+                break;
+              }
+            }
+          }
+        }
+
+        for (size_t j (0); j != n; ++j)
+        {
+          if (keep[j])
+          {
+            r.append (' ');
+            r.append (s, l.joins[j].text);
+          }
+        }
+
+        break;
       }
     }
 
+    // Trailer.
+    //
+    if (l.trailer.size != 0)
+    {
+      r.append (' ');
+      r.append (s, l.trailer);
+    }
+
+    size_t rn (r.end ());
+
 #ifdef LIBODB_TRACE_STATEMENT_PROCESSING
-    if (r.size () != n)
+    if (rn != l.size)
       cerr << endl
            << "old: '" << s << "'" << endl << endl
-           << "new: '" << r << "'" << endl << endl;
+           << "new: '" << r.data () << "'" << endl << endl;
 #endif
+
+    return rn;
+  }
+
+  void statement::
+  process (const layout& l,
+           bind_type bind,
+           size_t bind_size,
+           size_t bind_skip,
+           string& r,
+           bool optimize)
+  {
+    r.clear ();
+    r.reserve (layout_bound (l));
+
+    string_splice sp (r);
+    process_layout (l, bind, bind_size, bind_skip, sp, optimize);
+  }
+
+  size_t statement::
+  process (const layout& l,
+           bind_type bind,
+           size_t bind_size,
+           size_t bind_skip,
+           details::buffer& r,
+           bool optimize)
+  {
+    r.capacity (layout_bound (l));
+
+    array_splice sp (r.data ());
+    return process_layout (l, bind, bind_size, bind_skip, sp, optimize);
+  }
+
+  // Processed statement cache.
+  //
+  statement::processed_cache::
+  processed_cache (size_t capacity)
+      : capacity_ (capacity != 0 ? capacity : 1)
+  {
+  }
+
+  // Presence of the bind elements [i, i + 8) packed into a byte.
+  //
+  static inline unsigned char
+  presence_byte (size_t i,
+                 bind_type bind,
+                 size_t bind_size,
+                 size_t bind_skip,
+                 const dirty_mask* changed)
+  {
+    unsigned char c (0);
+
+    for (size_t j (0); j != 8 && i + j != bind_size; ++j)
+    {
+      if (bind_at (i + j, bind, bind_skip) != 0 &&
+          (changed == 0 || changed->test (i + j)))
+        c |= static_cast<unsigned char> (1U << j);
+    }
+
+    return c;
+  }
+
+  static inline unsigned int
+  processed_args (char kind, char a0, char a1, char a2)
+  {
+    return static_cast<unsigned char> (kind) |
+      static_cast<unsigned int> (static_cast<unsigned char> (a0)) << 8 |
+      static_cast<unsigned int> (static_cast<unsigned char> (a1)) << 16 |
+      static_cast<unsigned int> (static_cast<unsigned char> (a2)) << 24;
+  }
+
+  statement::processed_cache::entry& statement::processed_cache::
+  lookup (const char* text,
+          unsigned int args,
+          bind_type bind,
+          size_t bind_size,
+          size_t bind_skip,
+          const dirty_mask* changed,
+          bool& hit)
+  {
+    if (entries_.empty ())
+      entries_.resize (capacity_);
+
+    // FNV-1a over the presence pattern.
+    //
+    size_t h (static_cast<size_t> (2166136261UL));
+
+    for (size_t i (0); i < bind_size; i += 8)
+    {
+      h ^= presence_byte (i, bind, bind_size, bind_skip, changed);
+      h *= static_cast<size_t> (16777619UL);
+    }
+
+    size_t k (h ^ (reinterpret_cast<size_t> (text) >> 3) ^ args * 31U);
+    entry& e (entries_[k % capacity_]);
+
+    hit = e.text == text &&
+      e.args == args &&
+      e.hash == h &&
+      e.bind_size == bind_size;
+
+    for (size_t i (0); hit && i < bind_size; i += 8)
+      hit = e.mask[i / 8] ==
+        presence_byte (i, bind, bind_size, bind_skip, changed);
+
+    if (!hit)
+    {
+      e.text = 0;
+      e.args = args;
+      e.hash = h;
+      e.bind_size = bind_size;
+      e.mask.resize ((bind_size + 7) / 8);
+
+      for (size_t i (0); i < bind_size; i += 8)
+        e.mask[i / 8] =
+          presence_byte (i, bind, bind_size, bind_skip, changed);
+    }
+
+    return e;
+  }
+
+  const string& statement::
+  process_insert_cached (processed_cache& c,
+                         const char* s,
+                         bind_type bind,
+                         size_t bind_size,
+                         size_t bind_skip,
+                         char param_symbol)
+  {
+    bool hit;
+    processed_cache::entry& e (
+      c.lookup (s,
+                processed_args ('i', param_symbol, 0, 0),
+                bind,
+                bind_size,
+                bind_skip,
+                0,
+                hit));
+
+    if (!hit)
+    {
+      process_insert (s, bind, bind_size, bind_skip, param_symbol, e.result);
+      e.text = s;
+    }
+
+    return e.result;
+  }
+
+  const string& statement::
+  process_update_cached (processed_cache& c,
+                         const char* s,
+                         bind_type bind,
+                         size_t bind_size,
+                         size_t bind_skip,
+                         char param_symbol)
+  {
+    bool hit;
+    processed_cache::entry& e (
+      c.lookup (s,
+                processed_args ('u', param_symbol, 0, 0),
+                bind,
+                bind_size,
+                bind_skip,
+                0,
+                hit));
+
+    if (!hit)
+    {
+      process_update (s, bind, bind_size, bind_skip, param_symbol, e.result);
+      e.text = s;
+    }
+
+    return e.result;
+  }
+
+  const string& statement::
+  process_update_changed (processed_cache& c,
+                          const char* s,
+                          bind_type bind,
+                          size_t bind_size,
+                          size_t bind_skip,
+                          const dirty_mask& changed,
+                          char param_symbol)
+  {
+    bool hit;
+    processed_cache::entry& e (
+      c.lookup (s,
+                processed_args ('u', param_symbol, 0, 0),
+                bind,
+                bind_size,
+                bind_skip,
+                &changed,
+                hit));
+
+    if (!hit)
+    {
+      // Build the presence view with the unchanged elements absent. Only
+      // fall back to the heap for unusually wide statements.
+      //
+      const size_t view_cap = 64;
+      const void* view_buf[view_cap];
+      vector<const void*> view_vec;
+
+      const void** v (view_buf);
+      if (bind_size > view_cap)
+      {
+        view_vec.resize (bind_size);
+        v = &view_vec[0];
+      }
+
+      for (size_t i (0); i != bind_size; ++i)
+        v[i] = changed.test (i) ? bind_at (i, bind, bind_skip) : 0;
+
+      process_update (s,
+                      bind_size != 0 ? v : bind,
+                      bind_size,
+                      sizeof (const void*),
+                      param_symbol,
+                      e.result);
+      e.text = s;
+    }
+
+    return e.result;
+  }
+
+  const string& statement::
+  process_select_cached (processed_cache& c,
+                         const char* s,
+                         bind_type bind,
+                         size_t bind_size,
+                         size_t bind_skip,
+                         char quote_open,
+                         char quote_close,
+                         bool optimize,
+                         bool as)
+  {
+    bool hit;
+    processed_cache::entry& e (
+      c.lookup (s,
+                processed_args (
+                  's',
+                  quote_open,
+                  quote_close,
+                  static_cast<char> ((optimize ? 1 : 0) | (as ? 2 : 0))),
+                bind,
+                bind_size,
+                bind_skip,
+                0,
+                hit));
+
+    if (!hit)
+    {
+      process_select (s,
+                      bind,
+                      bind_size,
+                      bind_skip,
+                      quote_open,
+                      quote_close,
+                      optimize,
+                      e.result,
+                      as);
+      e.text = s;
+    }
+
+    return e.result;
   }
 }
@@ -8,11 +8,14 @@
 #include <odb/pre.hxx>
 
 #include <string>
+#include <vector>
 #include <cstddef> // std::size_t
 
 #include <odb/forward.hxx> // connection
+#include <odb/dirty-mask.hxx>
 
 #include <odb/details/export.hxx>
+#include <odb/details/buffer.hxx>
 #include <odb/details/shared-ptr.hxx>
 
 namespace odb
@@ -98,6 +101,217 @@ namespace odb
                     bool optimize,           // Remove unused JOINs.
                     std::string& result,
                     bool as = true);         // JOINs use AS keyword.
+
+    // Processed statement cache. The result of the above functions
+    // only depends on the statement text, the processing arguments, and
+    // which bind elements are present. The cache remembers the results
+    // by the statement text address, the arguments, and the bind
+    // presence pattern so that re-preparing the statement with the same
+    // pattern does not re-scan the text.
+    //
+    // The cache holds at most capacity results with a new result
+    // replacing the one (if any) occupying the same slot. It is not
+    // thread-safe and is normally kept per connection, along with the
+    // prepared statements. Note also that the statement text must be
+    // static (as is the case for the generated statements) since it is
+    // identified by its address.
+    //
+    class LIBODB_EXPORT processed_cache
+    {
+    public:
+      explicit
+      processed_cache (std::size_t capacity = 64);
+
+    private:
+      processed_cache (const processed_cache&);
+      processed_cache& operator= (const processed_cache&);
+
+    private:
+      friend class statement;
+
+      struct entry
+      {
+        entry (): text (0), args (0), hash (0), bind_size (0) {}
+
+        const char* text;
+        unsigned int args;          // Kind and processing arguments.
+        std::size_t hash;           // Presence pattern hash.
+        std::size_t bind_size;
+        std::vector<unsigned char> mask; // Presence, 8 elements per byte.
+        std::string result;
+      };
+
+      // Return the entry for the statement and set hit to true if it
+      // holds the result. Otherwise, the entry is reset to the new key
+      // with text set to NULL until the result is filled in. If changed
+      // is not NULL, then only the changed elements count as present.
+      //
+      entry&
+      lookup (const char* text,
+              unsigned int args,
+              const void* const* bind,
+              std::size_t bind_size,
+              std::size_t bind_skip,
+              const dirty_mask* changed,
+              bool& hit);
+
+      std::vector<entry> entries_;
+      std::size_t capacity_;
+    };
+
+    // Cached versions of the above functions. The returned reference
+    // is valid until the next call with the same cache.
+    //
+    static const std::string&
+    process_insert_cached (processed_cache&,
+                           const char* statement,
+                           const void* const* bind,
+                           std::size_t bind_size,
+                           std::size_t bind_skip,
+                           char param_symbol);
+
+    static const std::string&
+    process_update_cached (processed_cache&,
+                           const char* statement,
+                           const void* const* bind,
+                           std::size_t bind_size,
+                           std::size_t bind_skip,
+                           char param_symbol);
+
+    static const std::string&
+    process_select_cached (processed_cache&,
+                           const char* statement,
+                           const void* const* bind,
+                           std::size_t bind_size,
+                           std::size_t bind_skip,
+                           char quote_open,
+                           char quote_close,
+                           bool optimize,
+                           bool as = true);
+
+    // Partial UPDATE. As process_update_cached() but only keep the SET
+    // elements that are both present in bind and marked as changed in
+    // the mask (bit i corresponds to bind element i). The statement is
+    // processed once for each distinct pattern of changed columns.
+    //
+    // Note that the caller should not execute the statement if none of
+    // the present elements are changed. The bind elements that are not
+    // changed should also be omitted when binding the parameters, the
+    // same as for the absent ones.
+    //
+    static const std::string&
+    process_update_changed (processed_cache&,
+                            const char* statement,
+                            const void* const* bind,
+                            std::size_t bind_size,
+                            std::size_t bind_skip,
+                            const dirty_mask& changed,
+                            char param_symbol);
+
+    // Precompiled statement layout. Compiling the statement records the
+    // positions of its parts and list elements as well as, for SELECT,
+    // which elements refer to each JOIN alias. Processing the statement
+    // for a particular set of present bind elements then only splices
+    // the recorded ranges into the result without scanning the text.
+    // The result is the same as that of the corresponding process_*()
+    // function above.
+    //
+    struct LIBODB_EXPORT layout
+    {
+      enum kind_type
+      {
+        kind_insert,
+        kind_update,
+        kind_select
+      };
+
+      // Range of statement text. Empty if size is 0.
+      //
+      struct range
+      {
+        range (): begin (0), size (0) {}
+
+        std::size_t begin;
+        std::size_t size;
+      };
+
+      // INSERT column (with value), UPDATE SET expression, or SELECT
+      // column. Bind is the index of the corresponding bind element or
+      // ~0 if the element is not parameterized (always present).
+      //
+      struct element
+      {
+        range text;
+        range value;
+        std::size_t bind;
+      };
+
+      // SELECT JOIN. The columns and joins vectors contain the indexes
+      // of the elements and other JOINs that refer to this JOIN's alias.
+      // Fixed is true if the alias is referred to from the header, FROM,
+      // or the trailer.
+      //
+      struct join
+      {
+        range text;
+        bool fixed;
+        std::vector<std::size_t> columns;
+        std::vector<std::size_t> joins;
+      };
+
+      kind_type kind;
+      const char* statement;
+      std::size_t size;    // Statement text length.
+      std::size_t binds;   // Number of parameterized elements.
+      bool values;         // INSERT has the VALUES list.
+
+      range header;
+      range output;        // INSERT OUTPUT.
+      range from;          // SELECT FROM.
+      range trailer;
+
+      std::vector<element> elements;
+      std::vector<join> joins;
+
+      std::string fast;    // Result if all the elements are present.
+    };
+
+    static void
+    compile_insert (const char* statement, char param_symbol, layout&);
+
+    static void
+    compile_update (const char* statement, char param_symbol, layout&);
+
+    static void
+    compile_select (const char* statement,
+                    char quote_open,
+                    char quote_close,
+                    layout&,
+                    bool as = true);
+
+    // The optimize argument is only used for SELECT.
+    //
+    static void
+    process (const layout&,
+             const void* const* bind,
+             std::size_t bind_size,
+             std::size_t bind_skip,
+             std::string& result,
+             bool optimize = false);
+
+    // As above but write the NUL-terminated result into the buffer and
+    // return its size (excluding '\0'). The buffer is grown, if
+    // necessary, to the upper bound on the result size which is computed
+    // from the statement size (plus 16) so that reusing the same buffer
+    // for the same statement never allocates.
+    //
+    static std::size_t
+    process (const layout&,
+             const void* const* bind,
+             std::size_t bind_size,
+             std::size_t bind_skip,
+             details::buffer& result,
+             bool optimize = false);
   };
 }
 
@@ -2,10 +2,16 @@
 // copyright : Copyright (c) 2009-2015 Code Synthesis Tools CC
 // license   : GNU GPL v2; see accompanying LICENSE file
 
+#include <string>
+
+#include <odb/database.hxx>
 #include <odb/transaction.hxx>
 #include <odb/exceptions.hxx>
 
 #include <odb/details/tls.hxx>
+#include <odb/details/lock.hxx>
+#include <odb/details/mutex.hxx>
+#include <odb/details/condition.hxx>
 
 using namespace std;
 
@@ -93,6 +99,7 @@ namespace odb
       throw transaction_already_finalized ();
 
     finalized_ = true;
+    savepoints_.clear ();
     rollback_guard rg (*this);
 
     impl_->connection ().transaction_tracer_ = 0;
@@ -110,6 +117,168 @@ namespace odb
       callback_call (event_commit);
   }
 
+  // Asynchronous commit.
+  //
+  struct async_commit_state: commit_future::state
+  {
+    async_commit_state (): cond (mutex), done (false) {}
+
+    virtual bool
+    ready ()
+    {
+      details::lock l (mutex);
+      return done;
+    }
+
+    virtual void
+    wait ()
+    {
+      details::lock l (mutex);
+
+      while (!done)
+        cond.wait ();
+    }
+
+    void
+    complete ()
+    {
+      details::lock l (mutex);
+      done = true;
+      cond.broadcast ();
+    }
+
+    details::mutex mutex;
+    details::condition cond;
+    bool done;
+  };
+
+  struct async_commit: database::async_task
+  {
+    virtual void
+    execute ();
+
+    commit_future future;
+    async_commit_state* state;
+    details::unique_ptr<transaction_impl> impl;
+    vector<transaction::callback_data> callbacks;
+  };
+
+  void async_commit::
+  execute ()
+  {
+    unsigned short event (transaction::event_commit);
+
+    try
+    {
+      impl->commit ();
+      state->committed = true;
+    }
+    catch (const odb::exception& e)
+    {
+      state->error.reset (e.clone ());
+      event = transaction::event_rollback;
+    }
+    catch (...)
+    {
+      event = transaction::event_rollback;
+    }
+
+    // There is nobody to report the callback exceptions to so ignore
+    // them and call the rest.
+    //
+    for (size_t i (0); i != callbacks.size (); ++i)
+    {
+      transaction::callback_data& d (callbacks[i]);
+
+      if (d.event & event)
+      {
+        try {d.func (event, d.key, d.data);} catch (...) {}
+      }
+    }
+
+    state->complete ();
+  }
+
+  commit_future transaction::
+  commit_async ()
+  {
+    if (finalized_)
+      throw transaction_already_finalized ();
+
+    details::unique_ptr<async_commit> a (new async_commit);
+    a->state = new async_commit_state;
+    a->future = commit_future (a->state);
+
+    // Move the callbacks over to the task except for those registered
+    // with the state argument. Such a callback belongs to an object (for
+    // example, a change-tracked container) that assumes it is
+    // unregistered once the state is reset and may then be destroyed, so
+    // it cannot be called later from the background thread. Instead,
+    // detach it the same way as callback_call() and call it now.
+    //
+    size_t stack_count (callback_count_ < stack_callback_count
+                        ? callback_count_ : stack_callback_count);
+
+    vector<callback_data> detached;
+    a->callbacks.reserve (callback_count_);
+
+    for (size_t i (0); i != callback_count_; ++i)
+    {
+      callback_data& d (i < stack_count
+                        ? stack_callbacks_[i]
+                        : dyn_callbacks_[i - stack_callback_count]);
+
+      if (d.event == 0)
+        continue;
+
+      if (d.state != 0)
+      {
+        *d.state = 0;
+        detached.push_back (d);
+      }
+      else
+        a->callbacks.push_back (d);
+    }
+
+    commit_future r (a->future);
+
+    finalized_ = true;
+    savepoints_.clear ();
+
+    dyn_callbacks_.clear ();
+    callback_index_.clear ();
+    callback_index_count_ = 0;
+    callback_index_dups_ = 0;
+    free_callback_ = max_callback_count;
+    callback_count_ = 0;
+
+    impl_->connection ().transaction_tracer_ = 0;
+
+    if (tls_get (current_transaction) == this)
+    {
+      transaction* t (0);
+      tls_set (current_transaction, t);
+    }
+
+    database_type& db (impl_->database ());
+    a->impl.reset (impl_.release ());
+    db.async_ (a.release ());
+
+    // The same as in async_commit::execute(), ignore the exceptions.
+    //
+    for (size_t i (0); i != detached.size (); ++i)
+    {
+      callback_data& d (detached[i]);
+
+      if (d.event & event_rollback)
+      {
+        try {d.func (event_rollback, d.key, d.data);} catch (...) {}
+      }
+    }
+
+    return r;
+  }
+
   void transaction::
   rollback ()
   {
@@ -117,6 +286,7 @@ namespace odb
       throw transaction_already_finalized ();
 
     finalized_ = true;
+    savepoints_.clear ();
     rollback_guard rg (*this);
 
     impl_->connection ().transaction_tracer_ = 0;
@@ -181,6 +351,13 @@ namespace odb
     if (dyn_count != 0)
       dyn_callbacks_.clear ();
 
+    if (!callback_index_.empty ())
+    {
+      callback_index_.clear ();
+      callback_index_count_ = 0;
+      callback_index_dups_ = 0;
+    }
+
     free_callback_ = max_callback_count;
     callback_count_ = 0;
   }
@@ -192,15 +369,17 @@ namespace odb
                      unsigned long long data,
                      transaction** state)
   {
+    size_t i;
     callback_data* s;
 
     // If we have a free slot, use it.
     //
     if (free_callback_ != max_callback_count)
     {
-      s = (free_callback_ < stack_callback_count)
-        ? stack_callbacks_ + free_callback_
-        : &dyn_callbacks_[free_callback_ - stack_callback_count];
+      i = free_callback_;
+      s = (i < stack_callback_count)
+        ? stack_callbacks_ + i
+        : &dyn_callbacks_[i - stack_callback_count];
 
       free_callback_ = reinterpret_cast<size_t> (s->key);
     }
@@ -208,13 +387,15 @@ namespace odb
     //
     else if (callback_count_ < stack_callback_count)
     {
-      s = stack_callbacks_ + callback_count_;
+      i = callback_count_;
+      s = stack_callbacks_ + i;
       callback_count_++;
     }
     // Otherwise use the dynamic storage.
     //
     else
     {
+      i = callback_count_;
       dyn_callbacks_.push_back (callback_data ());
       s = &dyn_callbacks_.back ();
       callback_count_++;
@@ -225,6 +406,155 @@ namespace odb
     s->event = event;
     s->data = data;
     s->state = state;
+    s->seq = ++callback_seq_;
+
+    if (!callback_index_.empty ())
+      callback_index_insert (key, i);
+    else if (i >= stack_callback_count)
+      callback_index_build ();
+  }
+
+  // Callback index.
+  //
+  static inline size_t
+  callback_hash (void* key, size_t mask)
+  {
+    size_t h (reinterpret_cast<size_t> (key));
+    h ^= h >> 16;
+    h *= 0x45d9f3bU;
+    h ^= h >> 16;
+    return h & mask;
+  }
+
+  void transaction::
+  callback_index_build ()
+  {
+    // Called when the first dynamic slot is allocated so there are no
+    // free slots (see callback_register()).
+    //
+    size_t n (64);
+    while (n < callback_count_ * 2)
+      n *= 2;
+
+    callback_index_entry e = {0, 0};
+    callback_index_.assign (n, e);
+    callback_index_count_ = 0;
+    callback_index_dups_ = 0;
+
+    for (size_t i (0); i != callback_count_; ++i)
+      callback_index_insert (
+        i < stack_callback_count
+        ? stack_callbacks_[i].key
+        : dyn_callbacks_[i - stack_callback_count].key,
+        i);
+  }
+
+  void transaction::
+  callback_index_insert (void* key, size_t slot)
+  {
+    if (key == 0)
+      return;
+
+    // Keep the load factor at or below 1/2.
+    //
+    if ((callback_index_count_ + 1) * 2 > callback_index_.size ())
+    {
+      vector<callback_index_entry> t (callback_index_.size () * 2);
+      t.swap (callback_index_);
+      callback_index_count_ = 0;
+
+      for (size_t i (0); i != t.size (); ++i)
+        if (t[i].key != 0)
+          callback_index_insert (t[i].key, t[i].slot);
+    }
+
+    size_t m (callback_index_.size () - 1);
+    for (size_t i (callback_hash (key, m));; i = (i + 1) & m)
+    {
+      callback_index_entry& e (callback_index_[i]);
+
+      // If the key is already registered, keep the lowest slot, the
+      // same as the linear search. The other one will be indexed by
+      // callback_index_erase() once this one is unregistered.
+      //
+      if (e.key == key)
+      {
+        if (slot < e.slot)
+          e.slot = slot;
+
+        callback_index_dups_++;
+        return;
+      }
+
+      if (e.key == 0)
+      {
+        e.key = key;
+        e.slot = slot;
+        callback_index_count_++;
+        return;
+      }
+    }
+  }
+
+  void transaction::
+  callback_index_erase (void* key, size_t slot)
+  {
+    if (key == 0)
+      return;
+
+    size_t m (callback_index_.size () - 1);
+    size_t i (callback_hash (key, m));
+
+    for (; callback_index_[i].key != key; i = (i + 1) & m)
+    {
+      if (callback_index_[i].key == 0)
+        return;
+    }
+
+    // Shift back the entries that follow in the same probe sequence so
+    // that no tombstones are necessary.
+    //
+    for (size_t j (i);;)
+    {
+      j = (j + 1) & m;
+
+      if (callback_index_[j].key == 0)
+        break;
+
+      size_t h (callback_hash (callback_index_[j].key, m));
+
+      // Move the entry unless its home position is cyclically in (i, j].
+      //
+      if (i <= j ? (h <= i || h > j) : (h <= i && h > j))
+      {
+        callback_index_[i] = callback_index_[j];
+        i = j;
+      }
+    }
+
+    callback_index_[i].key = 0;
+    callback_index_count_--;
+
+    // If there could be another callback with the same key, index the
+    // next one (the slot being unregistered is still occupied).
+    //
+    if (callback_index_dups_ != 0)
+    {
+      for (size_t j (0); j != callback_count_; ++j)
+      {
+        const callback_data& d (
+          j < stack_callback_count
+          ? stack_callbacks_[j]
+          : dyn_callbacks_[j - stack_callback_count]);
+
+        if (j != slot && d.seq != 0 && d.key == key)
+        {
+          callback_index_dups_--;
+          callback_index_insert (key, j);
+          break;
+        }
+      }
+    }
   }
 
   size_t transaction::
@@ -233,6 +563,22 @@ namespace odb
     if (callback_count_ == 0)
       return 0;
 
+    if (!callback_index_.empty () && key != 0)
+    {
+      size_t m (callback_index_.size () - 1);
+
+      for (size_t i (callback_hash (key, m));; i = (i + 1) & m)
+      {
+        const callback_index_entry& e (callback_index_[i]);
+
+        if (e.key == key)
+          return e.slot;
+
+        if (e.key == 0)
+          return callback_count_;
+      }
+    }
+
     size_t stack_count;
 
     // See if this is the last slot registered. This will be a fast path if,
@@ -277,6 +623,15 @@ namespace odb
     if (i == callback_count_)
       return;
 
+    if (!callback_index_.empty ())
+      callback_index_erase (key, i);
+
+    callback_release (i);
+  }
+
+  void transaction::
+  callback_release (size_t i)
+  {
     // See if this is the last slot registered.
     //
     if (i == callback_count_ - 1)
@@ -297,10 +652,126 @@ namespace odb
       //
       d.event = 0;
       d.key = reinterpret_cast<void*> (free_callback_);
+      d.seq = 0;
       free_callback_ = i;
     }
   }
 
+  // Savepoints.
+  //
+  static void
+  savepoint_name (size_t n, char* r)
+  {
+    char d[24];
+    size_t i (0);
+
+    do
+    {
+      d[i++] = static_cast<char> ('0' + n % 10);
+      n /= 10;
+    } while (n != 0);
+
+    const char p[] = "odb_sp_";
+    for (const char* c (p); *c != '\0'; ++c)
+      *r++ = *c;
+
+    while (i != 0)
+      *r++ = d[--i];
+
+    *r = '\0';
+  }
+
+  size_t transaction::
+  savepoint ()
+  {
+    if (finalized_)
+      throw transaction_already_finalized ();
+
+    char n[32];
+    savepoint_name (savepoints_.size () + 1, n);
+
+    impl_->savepoint_create (n);
+    savepoints_.push_back (callback_seq_);
+
+    return savepoints_.size ();
+  }
+
+  void transaction::
+  release_savepoint (size_t sp)
+  {
+    if (finalized_)
+      throw transaction_already_finalized ();
+
+    if (sp == 0 || sp > savepoints_.size ())
+      return;
+
+    // Releasing a savepoint also releases the ones created after it.
+    //
+    char n[32];
+    savepoint_name (sp, n);
+
+    impl_->savepoint_release (n);
+    savepoints_.resize (sp - 1);
+  }
+
+  void transaction::
+  rollback_savepoint (size_t sp)
+  {
+    if (finalized_)
+      throw transaction_already_finalized ();
+
+    if (sp == 0 || sp > savepoints_.size ())
+      return;
+
+    char n[32];
+    savepoint_name (sp, n);
+
+    impl_->savepoint_rollback (n);
+
+    size_t seq (savepoints_[sp - 1]);
+    savepoints_.resize (sp - 1);
+
+    // Unregister the callbacks that belong to the savepoint's scope
+    // before calling them in case they register new callbacks.
+    //
+    vector<callback_data> cs;
+
+    for (size_t i (callback_count_); i != 0;)
+    {
+      --i;
+
+      callback_data& d (
+        i < stack_callback_count
+        ? stack_callbacks_[i]
+        : dyn_callbacks_[i - stack_callback_count]);
+
+      if (d.seq > seq)
+      {
+        cs.push_back (d);
+
+        if (!callback_index_.empty () && callback_find (d.key) == i)
+          callback_index_erase (d.key, i);
+
+        callback_release (i);
+      }
+    }
+
+    // Same as in callback_call(), first reset all the states.
+    //
+    for (size_t i (0); i != cs.size (); ++i)
+    {
+      if (cs[i].event != 0 && cs[i].state != 0)
+        *cs[i].state = 0;
+    }
+
+    for (size_t i (0); i != cs.size (); ++i)
+    {
+      callback_data& d (cs[i]);
+      if (d.event & event_rollback)
+        d.func (event_rollback, d.key, d.data);
+    }
+  }
+
   void transaction::
   callback_update (void* key,
                    unsigned short event,
@@ -322,6 +793,7 @@ namespace odb
     d.event = event;
     d.data = data;
     d.state = state;
+    d.seq = ++callback_seq_;
   }
 
   //
@@ -332,4 +804,68 @@ namespace odb
   ~transaction_impl ()
   {
   }
+
+  void transaction_impl::
+  savepoint_create (const char* n)
+  {
+    connection ().execute (string ("SAVEPOINT ") + n);
+  }
+
+  void transaction_impl::
+  savepoint_rollback (const char* n)
+  {
+    connection ().execute (string ("ROLLBACK TO SAVEPOINT ") + n);
+    connection ().execute (string ("RELEASE SAVEPOINT ") + n);
+  }
+
+  void transaction_impl::
+  savepoint_release (const char* n)
+  {
+    connection ().execute (string ("RELEASE SAVEPOINT ") + n);
+  }
+
+  //
+  // nested_transaction
+  //
+
+  nested_transaction::
+  nested_transaction ()
+      : t_ (transaction::current ()), finalized_ (false)
+  {
+    savepoint_ = t_.savepoint ();
+  }
+
+  nested_transaction::
+  nested_transaction (transaction& t)
+      : t_ (t), finalized_ (false)
+  {
+    savepoint_ = t_.savepoint ();
+  }
+
+  nested_transaction::
+  ~nested_transaction ()
+  {
+    if (!finalized_ && !t_.finalized ())
+      try {rollback ();} catch (...) {}
+  }
+
+  void nested_transaction::
+  commit ()
+  {
+    if (finalized_)
+      throw transaction_already_finalized ();
+
+    finalized_ = true;
+    t_.release_savepoint (savepoint_);
+  }
+
+  void nested_transaction::
+  rollback ()
+  {
+    if (finalized_)
+      throw transaction_already_finalized ();
+
+    finalized_ = true;
+    t_.rollback_savepoint (savepoint_);
+  }
 }
@@ -11,6 +11,7 @@
 #include <cstddef> // std::size_t
 
 #include <odb/forward.hxx>
+#include <odb/commit-future.hxx>
 
 #include <odb/details/export.hxx>
 #include <odb/details/unique-ptr.hxx>
@@ -55,6 +56,24 @@ namespace odb
     void
     rollback ();
 
+    // Commit asynchronously. The transaction is finalized and handed
+    // over to a background thread (one per database) which commits it
+    // and calls the commit or rollback callbacks. The returned future
+    // can be used to wait for the outcome. Without thread support or if
+    // the database runtime has not enabled asynchronous commits (see
+    // database::async_commit()), the transaction is committed before
+    // this function returns.
+    //
+    // The callbacks registered with the state argument (for example, by
+    // change-tracked containers) are detached: their states are reset
+    // and, since the outcome is not yet known, they are conservatively
+    // called with event_rollback right away. The other callbacks are
+    // called in the background thread and their keys (for example,
+    // sections) should stay valid until the commit completes.
+    //
+    commit_future
+    commit_async ();
+
     // Return the database this transaction is on.
     //
     database_type&
@@ -68,6 +87,38 @@ namespace odb
     bool
     finalized () const {return finalized_;}
 
+    // Return true if this is a read-only transaction (see
+    // database::begin_read_only()).
+    //
+    bool
+    read_only () const;
+
+    // Savepoints. Create a savepoint and return its depth which is used
+    // to identify it in the calls below. Savepoints nest: releasing or
+    // rolling back to a savepoint also discards all the savepoints
+    // created after it. Calling these functions for a savepoint that has
+    // already been discarded has no effect.
+    //
+    // Rolling back to a savepoint undoes the changes made in the database
+    // since it was created and calls the rollback callbacks registered or
+    // updated (see callback_update()) since then. Such callbacks are also
+    // unregistered (with their states reset) so that an object armed
+    // before the savepoint and re-armed after it (for example, a change-
+    // tracked container or a section) conservatively treats its change
+    // as undone. Other callbacks are not affected. Both rolling back to
+    // and releasing a savepoint discard it.
+    //
+    // See also nested_transaction below.
+    //
+    std::size_t
+    savepoint ();
+
+    void
+    rollback_savepoint (std::size_t);
+
+    void
+    release_savepoint (std::size_t);
+
   public:
     // Return true if there is a transaction in effect.
     //
@@ -135,17 +186,24 @@ namespace odb
                        unsigned long long data = 0,
                        transaction** state = 0);
 
-    // Unregister a post-commit/rollback callback. Note that this is a
-    // potentially slow operation. You also don't need to unregister
-    // a callback that has been called or auto-reset using the state
-    // argument passed to register(). This function does nothing if
-    // the key is not found.
+    // Unregister a post-commit/rollback callback. Note that you don't
+    // need to unregister a callback that has been called or auto-reset
+    // using the state argument passed to register(). This function does
+    // nothing if the key is not found.
+    //
+    // Once the number of callbacks exceeds the number of pre-allocated
+    // slots (see below), the callbacks are indexed by key so that this
+    // function and update() are constant time. If several callbacks are
+    // registered with the same key, then the one in the lowest slot is
+    // found first and, while duplicates are present, unregistering an
+    // indexed callback is linear.
     //
     void
     callback_unregister (void* key);
 
-    // Update the event, data, and state values for a callback. Note
-    // that just like unregister(), this is a potentially slow operation.
+    // Update the event, data, and state values for a callback. This
+    // function does nothing if the key is not found. An updated callback
+    // belongs to the scope of the innermost savepoint (see above).
     //
     void
     callback_update (void* key,
@@ -165,6 +223,7 @@ namespace odb
 
   protected:
     friend struct rollback_guard;
+    friend struct async_commit;
 
     std::size_t
     callback_find (void* key);
@@ -172,6 +231,18 @@ namespace odb
     void
     callback_call (unsigned short event);
 
+    void
+    callback_index_build ();
+
+    void
+    callback_index_insert (void* key, std::size_t slot);
+
+    void
+    callback_index_erase (void* key, std::size_t slot);
+
+    void
+    callback_release (std::size_t slot);
+
   protected:
     bool finalized_;
     details::unique_ptr<transaction_impl> impl_;
@@ -185,6 +256,7 @@ namespace odb
       void* key;
       unsigned long long data;
       transaction** state;
+      std::size_t seq; // Registration sequence number or 0 if free.
     };
 
     // Slots for the first 20 callback are pre-allocated on the stack.
@@ -211,6 +283,33 @@ namespace odb
     // Total number of used slots, both registered and in the free list.
     //
     std::size_t callback_count_;
+
+    // Key to slot index. It is built once the callbacks spill over to
+    // the dynamic storage (at which point there are no free slots) and
+    // is empty otherwise. It is an open addressing hash table with the
+    // power of two size and linear probing. An entry with the NULL key
+    // is unused (callbacks registered with the NULL key are not indexed
+    // and are found with the linear search). Only the lowest slot of
+    // each key is indexed; callback_index_dups_ is the (upper bound on
+    // the) number of registered but not indexed duplicates.
+    //
+    struct callback_index_entry
+    {
+      void* key;
+      std::size_t slot;
+    };
+
+    std::vector<callback_index_entry> callback_index_;
+    std::size_t callback_index_count_;
+    std::size_t callback_index_dups_;
+
+    // Savepoints. For each active savepoint we store the callback
+    // sequence number at the time it was created. The callbacks with
+    // greater numbers (assigned on registration and update) belong to
+    // its scope.
+    //
+    std::size_t callback_seq_;
+    std::vector<std::size_t> savepoints_;
   };
 
   class LIBODB_EXPORT transaction_impl
@@ -231,6 +330,23 @@ namespace odb
     virtual void
     rollback () = 0;
 
+    // Savepoints. The rollback function should roll back to and discard
+    // the savepoint. The default implementations execute the standard
+    // SAVEPOINT, ROLLBACK TO SAVEPOINT, and RELEASE SAVEPOINT statements
+    // on the connection (rollback executes both of the latter), which
+    // works for PostgreSQL, MySQL, and SQLite. Oracle has no RELEASE
+    // SAVEPOINT and SQL Server uses SAVE/ROLLBACK TRANSACTION without a
+    // release, so these runtimes must override all three functions.
+    //
+    virtual void
+    savepoint_create (const char* name);
+
+    virtual void
+    savepoint_rollback (const char* name);
+
+    virtual void
+    savepoint_release (const char* name);
+
     database_type&
     database ()
     {
@@ -243,20 +359,78 @@ namespace odb
       return *connection_;
     }
 
+    // Read-only transaction. A runtime that supports read-only
+    // transactions passes the flag to the constructor so that it is
+    // already set when start() is called (see
+    // database::begin_read_only()).
+    //
+    bool
+    read_only () const
+    {
+      return read_only_;
+    }
+
+    void
+    read_only (bool r)
+    {
+      read_only_ = r;
+    }
+
   protected:
-    transaction_impl (database_type& db)
-        : database_ (db), connection_ (0)
+    transaction_impl (database_type& db, bool read_only = false)
+        : database_ (db), connection_ (0), read_only_ (read_only)
     {
     }
 
-    transaction_impl (database_type& db, connection_type& c)
-        : database_ (db), connection_ (&c)
+    transaction_impl (database_type& db,
+                      connection_type& c,
+                      bool read_only = false)
+        : database_ (db), connection_ (&c), read_only_ (read_only)
     {
     }
 
   protected:
     database_type& database_;
     connection_type* connection_;
+    bool read_only_;
+  };
+
+  // Nested transaction based on a savepoint in the enclosing
+  // transaction. Unless committed (the savepoint is released) or rolled
+  // back explicitly, the destructor rolls it back.
+  //
+  class LIBODB_EXPORT nested_transaction
+  {
+  public:
+    // Start a nested transaction in the current transaction.
+    //
+    nested_transaction ();
+
+    explicit
+    nested_transaction (transaction&);
+
+    ~nested_transaction ();
+
+    void
+    commit ();
+
+    void
+    rollback ();
+
+    bool
+    finalized () const {return finalized_;}
+
+    transaction&
+    enclosing () {return t_;}
+
+  private:
+    nested_transaction (const nested_transaction&);
+    nested_transaction& operator= (const nested_transaction&);
+
+  private:
+    transaction& t_;
+    std::size_t savepoint_;
+    bool finalized_;
   };
 }
 
@@ -11,7 +11,10 @@ namespace odb
       : finalized_ (true),
         impl_ (0),
         free_callback_ (max_callback_count),
-        callback_count_ (0)
+        callback_count_ (0),
+        callback_index_count_ (0),
+        callback_index_dups_ (0),
+        callback_seq_ (0)
   {
   }
 
@@ -20,7 +23,10 @@ namespace odb
       : finalized_ (true),
         impl_ (0),
         free_callback_ (max_callback_count),
-        callback_count_ (0)
+        callback_count_ (0),
+        callback_index_count_ (0),
+        callback_index_dups_ (0),
+        callback_seq_ (0)
   {
     reset (impl, make_current);
   }
@@ -37,6 +43,12 @@ namespace odb
     return impl_->connection ();
   }
 
+  inline bool transaction::
+  read_only () const
+  {
+    return impl_->read_only ();
+  }
+
   inline transaction_impl& transaction::
   implementation ()
   {
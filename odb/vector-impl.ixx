@@ -194,6 +194,24 @@ namespace odb
   inline void vector_base::
   _arm (transaction& t) const
   {
+    // Nothing can be changed in a read-only transaction so there is
+    // nothing to roll back.
+    //
+    if (t.read_only ())
+      return;
+
+    // If already armed, then only re-arm the existing callback so that
+    // it belongs to the current savepoint scope.
+    //
+    if (tran_ == &t)
+    {
+      t.callback_update (const_cast<vector_base*> (this),
+                         transaction::event_rollback,
+                         0,
+                         &tran_);
+      return;
+    }
+
     tran_ = &t;
     t.callback_register (&rollback,
                          const_cast<vector_base*> (this),